@@ -23,6 +23,8 @@ struct DrawCommandPartial {
     DrawCommand<Vertex, Material> withTransform(const glm::mat4& modelMatrix) {
         return DrawCommand<Vertex, Material>{mesh, materialIndex, modelMatrix};
     }
+
+    bool operator==(const DrawCommandPartial&) const = default;
 };
 
 template <typename Vertex, typename Material>
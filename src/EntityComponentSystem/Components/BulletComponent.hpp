@@ -1,7 +1,7 @@
 #pragma once
 
+// Expiry is not polled, the spawner schedules it on ECS::timers for the
+// time the bullet needs to cover BULLET_RANGE.
 struct BulletComponent {
     float angle;
-    float distance;
-    float traveledDistance = 0.0f;
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+enum class CollisionLayer : uint8_t {
+    Default,  // entities without a CollisionLayerComponent, touch everything
+    Player,
+    Follower,
+    Bullet,
+    Coin,
+    Static,
+    COUNT
+};
+
+// Every pair of layers whose members can touch. Pairs missing here are
+// rejected before the narrowphase and never reach the contact rules.
+constexpr std::pair<CollisionLayer, CollisionLayer> COLLISION_LAYER_PAIRS[] = {
+    {CollisionLayer::Player, CollisionLayer::Follower},
+    {CollisionLayer::Player, CollisionLayer::Coin},
+    {CollisionLayer::Player, CollisionLayer::Static},
+    {CollisionLayer::Follower, CollisionLayer::Follower},
+    {CollisionLayer::Follower, CollisionLayer::Bullet},
+    {CollisionLayer::Follower, CollisionLayer::Static},
+    {CollisionLayer::Bullet, CollisionLayer::Static},
+};
+
+constexpr uint32_t collisionLayerBit(CollisionLayer layer) {
+    return uint32_t{1} << static_cast<uint32_t>(layer);
+}
+
+// Layers `layer` can touch, read from COLLISION_LAYER_PAIRS in both directions.
+constexpr uint32_t collisionMaskOf(CollisionLayer layer) {
+    if (layer == CollisionLayer::Default) return ~uint32_t{0};
+    uint32_t mask = collisionLayerBit(CollisionLayer::Default);
+    for (const auto& [a, b] : COLLISION_LAYER_PAIRS) {
+        if (a == layer) mask |= collisionLayerBit(b);
+        if (b == layer) mask |= collisionLayerBit(a);
+    }
+    return mask;
+}
+
+static_assert(static_cast<size_t>(CollisionLayer::COUNT) <= 32, "Collision layers must fit the mask bits");
+
+struct CollisionLayerComponent {
+    CollisionLayer layer = CollisionLayer::Default;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+
 #include "HitBoxComponent.hpp"
 #include "MovableComponent.hpp"
 #include "PlayerMovementComponent.hpp"
@@ -10,6 +12,13 @@
 #include "RemoveComponent.hpp"
 #include "FollowPlayerComponent.hpp"
 #include "BulletComponent.hpp"
+#include "PreviousPositionComponent.hpp"
+#include "SharedComponent.hpp"
+#include "CollisionLayerComponent.hpp"
+#include "ContinuousCollisionComponent.hpp"
+#include "PooledComponent.hpp"
+#include "SleepStateComponent.hpp"
+#include "SimLodComponent.hpp"
 
 enum class ComponentType : size_t {
     MovableComponent = 0,
@@ -23,6 +32,15 @@ enum class ComponentType : size_t {
     RemoveComponent,
     FollowPlayerComponent,
     BulletComponent,
+    PreviousPositionComponent,
+    SharedRenderableUnlit,
+    SharedRenderableColored,
+    SimLodComponent,
+    SleepStateComponent,
+    SleepingComponent,
+    PooledComponent,
+    ContinuousCollisionComponent,
+    CollisionLayerComponent,
     COUNT
 };
 
@@ -83,4 +101,80 @@ struct ComponentToType<BulletComponent> {
     static constexpr ComponentType index = ComponentType::BulletComponent;
 };
 
+template <>
+struct ComponentToType<PreviousPositionComponent> {
+    static constexpr ComponentType index = ComponentType::PreviousPositionComponent;
+};
+
+template <>
+struct ComponentToType<SharedRenderableUnlit> {
+    static constexpr ComponentType index = ComponentType::SharedRenderableUnlit;
+};
+
+template <>
+struct ComponentToType<SharedRenderableColored> {
+    static constexpr ComponentType index = ComponentType::SharedRenderableColored;
+};
+
+template <>
+struct ComponentToType<SimLodComponent> {
+    static constexpr ComponentType index = ComponentType::SimLodComponent;
+};
+
+template <>
+struct ComponentToType<SleepStateComponent> {
+    static constexpr ComponentType index = ComponentType::SleepStateComponent;
+};
+
+template <>
+struct ComponentToType<SleepingComponent> {
+    static constexpr ComponentType index = ComponentType::SleepingComponent;
+};
+
+template <>
+struct ComponentToType<PooledComponent> {
+    static constexpr ComponentType index = ComponentType::PooledComponent;
+};
+
+template <>
+struct ComponentToType<ContinuousCollisionComponent> {
+    static constexpr ComponentType index = ComponentType::ContinuousCollisionComponent;
+};
+
+template <>
+struct ComponentToType<CollisionLayerComponent> {
+    static constexpr ComponentType index = ComponentType::CollisionLayerComponent;
+};
+
 constexpr size_t COMPONENT_COUNT = static_cast<size_t>(ComponentType::COUNT);
+
+// Display names indexed by ComponentType, used by the memory report.
+constexpr std::array<const char*, COMPONENT_COUNT> COMPONENT_NAMES = {
+    "MovableComponent",
+    "RenderableUnlit",
+    "RenderableColored",
+    "HitBoxComponent",
+    "PositionComponent",
+    "PlayerMovementComponent",
+    "CollidingComponent",
+    "CoinComponent",
+    "RemoveComponent",
+    "FollowPlayerComponent",
+    "BulletComponent",
+    "PreviousPositionComponent",
+    "SharedRenderableUnlit",
+    "SharedRenderableColored",
+    "SimLodComponent",
+    "SleepStateComponent",
+    "SleepingComponent",
+    "PooledComponent",
+    "ContinuousCollisionComponent",
+    "CollisionLayerComponent",
+};
+
+static_assert(COMPONENT_NAMES.back() != nullptr, "Every ComponentType needs a name");
+
+template <typename T>
+constexpr const char* componentName() {
+    return COMPONENT_NAMES[static_cast<size_t>(ComponentToType<T>::index)];
+}
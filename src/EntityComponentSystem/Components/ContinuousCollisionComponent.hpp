@@ -0,0 +1,5 @@
+#pragma once
+
+// Collides along its whole motion of the tick, from PreviousPositionComponent
+// to PositionComponent, so fast movers cannot step through thin targets.
+struct ContinuousCollisionComponent {};
@@ -2,5 +2,4 @@
 
 struct HitBoxComponent {
     float r = 0.0f;
-    std::unordered_set<size_t> collidedWith;
 };
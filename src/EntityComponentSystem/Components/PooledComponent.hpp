@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../Storage/TimerWheel.hpp"
+
+using PrefabID = uint32_t;
+
+// Marks an entity owned by a prefab pool, see ECS::spawn(). Removing it
+// through RemoveComponent returns it to the pool instead of destroying it.
+struct PooledComponent {
+    PrefabID prefab;
+    TimerHandle timer{};  // cancelled on despawn so it cannot fire into the next spawn
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+// Position at the start of the current simulation tick, rendering blends
+// between it and PositionComponent.
+struct PreviousPositionComponent {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+};
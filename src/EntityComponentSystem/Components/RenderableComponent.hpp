@@ -15,6 +15,8 @@ struct RenderableComponent {
     DrawCommand<Vertex, Material> withTransform(const glm::mat4& modelMatrix) {
         return partial.withTransform(modelMatrix);
     }
+
+    bool operator==(const RenderableComponent&) const = default;
 };
 
 using RenderableUnlit = RenderableComponent<UnlitVertex, UnlitMaterial>;
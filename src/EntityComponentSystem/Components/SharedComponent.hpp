@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "RenderableComponent.hpp"
+
+// Per-entity reference to a value deduplicated in SharedComponentStorage<T>.
+// Added through ECS::addSharedComponent, changed with ECS::setSharedComponent
+// and read with ECS::getSharedComponent.
+template <typename T>
+struct Shared {
+    std::uint32_t handle;
+};
+
+template <typename T>
+struct IsShared : std::false_type {};
+
+template <typename T>
+struct IsShared<Shared<T>> : std::true_type {};
+
+using SharedRenderableUnlit = Shared<RenderableUnlit>;
+using SharedRenderableColored = Shared<RenderableColored>;
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+// Simulation level of detail, the tier is refreshed by simLodTierSystem and
+// `due`/`step` by simLodScheduleSystem. Entities without it simulate every
+// tick.
+struct SimLodComponent {
+    uint8_t tier = 0;      // 0 near, 1 mid, 2 far
+    bool due = true;       // simulated during the current tick
+    float step = 0.0f;     // delta time to simulate with when due
+    float elapsed = 0.0f;  // time accumulated since the last due tick
+};
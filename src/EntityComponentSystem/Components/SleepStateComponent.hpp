@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// Lets an entity fall asleep once it stops moving, see SleepSystem.
+struct SleepStateComponent {
+    float x = 0.0f;            // position at the previous simulated tick
+    float y = 0.0f;
+    float dx = 0.0f;           // velocity when the entity fell asleep
+    float dy = 0.0f;
+    uint16_t stillTicks = 0;   // simulated ticks spent under the motion threshold
+    uint32_t slot = 0;         // index into SleepSystem's arrays, rewritten every tick
+};
+
+// Tag of sleeping entities, they are skipped by movement and only collide
+// with awake bodies.
+struct SleepingComponent {};
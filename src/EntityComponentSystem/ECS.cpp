@@ -1,20 +1,67 @@
 #include "ECS.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <future>
+#include <iostream>
 
 EntityID ECS::createEntity() {
     entityStorage.addEntity(nextEntity);
     return nextEntity++;
 }
 
+void CommandBuffer::removeEntity(EntityID id) {
+    commands.emplace_back([id](ECS& ecs) { ecs.removeEntity(id); });
+}
+
 void ECS::removeEntity(EntityID id) {
+    const auto mask = entityStorage.getComponentMask(id) & onRemoveObservers.observed;
+    for (size_t typeIndex = 0; typeIndex < COMPONENT_COUNT; ++typeIndex) {
+        if (mask.test(typeIndex)) onRemoveObservers.pending[typeIndex].push_back(id);
+    }
     for (auto& [type, storage] : storages) {
         storage->removeEntity(id, entityStorage);
     }
     entityStorage.removeEntity(id);
 }
 
+PrefabID ECS::registerPrefab(std::function<void(ECS&, EntityID)> build) {
+    prefabs.push_back({std::move(build), {}});
+    return static_cast<PrefabID>(prefabs.size() - 1);
+}
+
+EntityID ECS::spawn(PrefabID prefab) {
+    auto& pool = prefabs.at(prefab).pool;
+    // Pooled entities destroyed with removeEntity() leave stale ids behind.
+    while (!pool.empty() && !entityStorage.hasEntity(pool.back())) pool.pop_back();
+    EntityID id;
+    if (pool.empty()) {
+        id = createEntity();
+        addComponent(id, PooledComponent{prefab});
+    } else {
+        id = pool.back();
+        pool.pop_back();
+    }
+    // Inactive entities are in no query, so rewriting the components of a
+    // recycled one costs no query updates until it is activated.
+    prefabs[prefab].build(*this, id);
+    entityStorage.setActive(id, true);
+    return id;
+}
+
+void ECS::despawn(EntityID id) {
+    auto* pooled = getComponent<PooledComponent>(id);
+    if (pooled == nullptr) {
+        removeEntity(id);
+        return;
+    }
+    if (!entityStorage.isActive(id)) return;
+    timers.cancel(pooled->timer);
+    entityStorage.setActive(id, false);
+    prefabs[pooled->prefab].pool.push_back(id);
+}
+
 ECS& ECS::nextStage(StageType type) {
     stages.push_back({type, {}});
     return *this;
@@ -24,24 +71,196 @@ ECS& ECS::addSystem(std::function<void(ECS&, const float&, RenderingQueues&)> fn
     if (stages.empty()) {
         throw std::runtime_error("No stage defined. Call nextStage() first.");
     }
-    stages.back().systems.push_back(fn);
+    stages.back().systems.push_back({fn, {}, {}, {}});
+    return *this;
+}
+
+ECS::System& ECS::lastSystem() {
+    if (stages.empty() || stages.back().systems.empty()) {
+        throw std::runtime_error("No system to configure. Call addSystem() first.");
+    }
+    return stages.back().systems.back();
+}
+
+ECS& ECS::every(unsigned ticks) {
+    lastSystem().schedule.everyTicks = std::max(ticks, 1u);
     return *this;
 }
 
+ECS& ECS::atRate(float hz) {
+    lastSystem().schedule.interval = hz > 0.0f ? 1.0f / hz : 0.0f;
+    return *this;
+}
+
+ECS& ECS::withBudget(float seconds) {
+    lastSystem().schedule.budget = seconds;
+    return *this;
+}
+
+bool ECS::SystemSchedule::due(float deltaTime) {
+    ++ticksSinceRun;
+    elapsed += deltaTime;
+    return ticksSinceRun >= everyTicks && elapsed >= interval;
+}
+
+void ECS::runSystem(System& sys, const float& deltaTime) {
+    if (!sys.schedule.due(deltaTime)) return;
+    const float elapsed = sys.schedule.elapsed;
+    sys.schedule.ticksSinceRun = 0;
+    sys.schedule.elapsed = 0.0f;
+
+    runningSystem = &sys;
+    sys.slice.handedOut = 0;
+    const auto start = std::chrono::steady_clock::now();
+    sys.fn(*this, elapsed, renderingQueues);
+    const std::chrono::duration<float> spent = std::chrono::steady_clock::now() - start;
+    runningSystem = nullptr;
+
+    if (sys.slice.handedOut > 0) {
+        const float cost = spent.count() / static_cast<float>(sys.slice.handedOut);
+        auto& estimate = sys.slice.secondsPerEntity;
+        estimate = estimate > 0.0f ? 0.8f * estimate + 0.2f * cost : cost;
+    }
+}
+
+bool ECS::SystemAccess::conflictsWith(const SystemAccess& other) const {
+    auto touches = [](const std::vector<size_t>& ids, size_t id) {
+        return std::find(ids.begin(), ids.end(), id) != ids.end();
+    };
+    for (auto id : writes) {
+        if (touches(other.reads, id) || touches(other.writes, id)) return true;
+    }
+    for (auto id : other.writes) {
+        if (touches(reads, id)) return true;
+    }
+    return false;
+}
+
 void ECS::update(const float& deltaTime) {
+    timers.advance(commands);
+    flush();
+
+    // Cleared even when a system throws out of a parallel stage.
+    struct StageFlag {
+        bool& running;
+        ~StageFlag() { running = false; }
+    } flag{parallelStageRunning};
+
     for (auto& stage : stages) {
         if (stage.type == StageType::Parallel) {
-            std::vector<std::future<void>> tasks;
+            // A system joins the wave after the last one holding a conflicting
+            // system, so conflicting systems keep their registration order.
+            std::vector<std::vector<System*>> waves;
             for (auto& sys : stage.systems) {
-                tasks.push_back(std::async(std::launch::async, [&]() {
-                    sys(*this, deltaTime, renderingQueues);
-                }));
+                size_t wave = 0;
+                for (size_t i = 0; i < waves.size(); ++i) {
+                    for (const auto* member : waves[i]) {
+                        if (member->access.conflictsWith(sys.access)) wave = i + 1;
+                    }
+                }
+                if (wave == waves.size()) waves.emplace_back();
+                waves[wave].push_back(&sys);
+            }
+
+            parallelStageRunning = true;
+            for (auto& wave : waves) {
+                std::vector<std::future<void>> tasks;
+                for (auto* sys : wave) {
+                    tasks.push_back(std::async(std::launch::async, [&, sys]() {
+                        runSystem(*sys, deltaTime);
+                    }));
+                }
+                for (auto& t : tasks) t.get();
             }
-            for (auto& t : tasks) t.get();
+            parallelStageRunning = false;
         } else {
             for (auto& sys : stage.systems) {
-                sys(*this, deltaTime, renderingQueues);
+                runSystem(sys, deltaTime);
             }
         }
+        flush();
+    }
+}
+
+ECS& ECS::addRenderSystem(std::function<void(ECS&, const float&, RenderingQueues&)> fn) {
+    renderSystems.push_back(fn);
+    return *this;
+}
+
+void ECS::render(const float& alpha, RenderingQueues& queues) {
+    for (auto& sys : renderSystems) {
+        sys(*this, alpha, queues);
+    }
+    flush();
+}
+
+bool ECS::dispatch(ObserverList& list) {
+    bool dispatched = false;
+    for (size_t typeIndex = 0; typeIndex < COMPONENT_COUNT; ++typeIndex) {
+        if (list.pending[typeIndex].empty()) continue;
+        // Observers may trigger further events of the same type, those are
+        // picked up by the next round of flush().
+        std::swap(list.batch, list.pending[typeIndex]);
+        for (auto& observer : list.observers[typeIndex]) {
+            observer(*this, list.batch);
+        }
+        list.batch.clear();
+        dispatched = true;
+    }
+    return dispatched;
+}
+
+void ECS::flush() {
+    bool pending = true;
+    while (pending) {
+        pending = !commands.empty();
+        commands.apply(*this);
+        pending |= dispatch(onAddObservers);
+        pending |= dispatch(onSetObservers);
+        pending |= dispatch(onRemoveObservers);
+    }
+}
+
+void ECS::trackMemory(MemoryStats& stats) {
+    auto& highWater = memoryHighWater[stats.name];
+    highWater = std::max(highWater, stats.capacityBytes);
+    stats.highWaterBytes = highWater;
+
+    auto budget = memoryBudgets.find(stats.name);
+    if (budget == memoryBudgets.end()) return;
+    const bool exceeded = stats.capacityBytes > budget->second.bytes;
+    if (exceeded && !budget->second.exceeded) {
+        std::cerr << "Memory budget exceeded: " << stats.name << " uses "
+                  << stats.capacityBytes << " of " << budget->second.bytes << " bytes\n";
+    }
+    budget->second.exceeded = exceeded;
+}
+
+MemoryReport ECS::memoryReport() {
+    MemoryReport report;
+    report.storages.reserve(storages.size() + 3);
+    for (auto& [type, storage] : storages) {
+        report.storages.push_back(storage->memoryStats());
+    }
+    report.storages.push_back(entityStorage.memoryStats());
+    report.storages.push_back(contacts.memoryStats());
+    report.storages.push_back(contactPairs.memoryStats());
+    report.queries = entityStorage.queryMemoryStats();
+
+    for (auto* group : {&report.storages, &report.queries}) {
+        for (auto& stats : *group) {
+            trackMemory(stats);
+            report.liveBytes += stats.liveBytes;
+            report.capacityBytes += stats.capacityBytes;
+        }
     }
+    MemoryStats total{"total", report.liveBytes, report.capacityBytes};
+    trackMemory(total);
+    report.highWaterBytes = total.highWaterBytes;
+    return report;
+}
+
+ECS& ECS::setMemoryBudget(const std::string& name, size_t bytes) {
+    memoryBudgets[name] = {bytes};
+    return *this;
 }
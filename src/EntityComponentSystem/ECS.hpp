@@ -1,11 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <unordered_map>
 #include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <typeindex>
 #include <vector>
 #include <memory>
+#include "Storage/CommandBuffer.hpp"
 #include "Storage/ComponentStorage.hpp"
+#include "Storage/ContactBuffer.hpp"
+#include "Storage/ContactPairCache.hpp"
+#include "Storage/StorageSelector.hpp"
+#include "Storage/TimerWheel.hpp"
 #include "Storage/EntityStorage.hpp"
 #include "Storage/QueryBuilder.hpp"
 #include "mesh.h"
@@ -21,6 +32,7 @@ struct RenderingQueues {
 class ECS {
 public:
     enum class StageType { Sequential, Parallel };
+    using Observer = std::function<void(ECS&, std::span<const EntityID>)>;
 
     ECS(RenderingQueues&& renderingQueues): renderingQueues(std::move(renderingQueues)) {}
 
@@ -28,37 +40,294 @@ private:
     EntityID nextEntity = 0;
     std::unordered_map<std::type_index, std::unique_ptr<IStorage>> storages;
 
+    // Resources a system declared it reads or writes, used to keep
+    // conflicting systems of a parallel stage from running at the same time.
+    struct SystemAccess {
+        std::vector<size_t> reads;
+        std::vector<size_t> writes;
+
+        bool conflictsWith(const SystemAccess& other) const;
+    };
+
+    // When a system runs, see every(), atRate() and withBudget().
+    struct SystemSchedule {
+        unsigned everyTicks = 1;
+        float interval = 0.0f;      // seconds between runs
+        float budget = 0.0f;        // seconds per run, 0 runs the whole query
+        unsigned ticksSinceRun = 0;
+        float elapsed = 0.0f;       // delta time accumulated since the last run
+
+        bool due(float deltaTime);
+    };
+
+    // Round-robin walk over a query for budgetedSlice().
+    struct SystemSlice {
+        std::vector<EntityID> entities;  // query snapshot taken when the walk starts
+        size_t cursor = 0;
+        size_t scan = 0;                 // next entity to test for readiness, at or after cursor
+        size_t handedOut = 0;            // entities given out during the current run
+        float secondsPerEntity = 0.0f;   // running estimate from previous runs
+    };
+
+    struct System {
+        std::function<void(ECS&, const float&, RenderingQueues&)> fn;
+        SystemAccess access;
+        SystemSchedule schedule;
+        SystemSlice slice;
+    };
+
+    // Entities budgetedSlice() may test for readiness per entity it may hand out.
+    static constexpr size_t ready_scan_factor = 4;
+
+    static inline thread_local System* runningSystem = nullptr;
+    // Walk of budgetedSlice() calls made outside update(), e.g. when a system
+    // is invoked directly.
+    SystemSlice unscheduledSlice;
+    void runSystem(System& sys, const float& deltaTime);
+
     struct Stage {
         StageType type;
-        std::vector<std::function<void(ECS&, const float&, RenderingQueues&)>> systems;
+        std::vector<System> systems;
     };
     std::vector<Stage> stages;
 
+    static inline std::atomic<size_t> nextResourceId{0};
+    std::vector<std::shared_ptr<void>> resources;
+    // Set while update() runs a parallel stage, when resources must not grow.
+    bool parallelStageRunning = false;
+
+    template<typename T>
+    static size_t resourceId() {
+        static const size_t id = nextResourceId++;
+        return id;
+    }
+
+    System& lastSystem();
+    std::vector<std::function<void(ECS&, const float&, RenderingQueues&)>> renderSystems;
+
     template<typename T>
-    ComponentStorage<T>& getStorage() {
+    StorageFor<T>& getStorage() {
         auto type = std::type_index(typeid(T));
         if (storages.find(type) == storages.end()) {
-            storages[type] = std::make_unique<ComponentStorage<T>>();
+            storages[type] = std::make_unique<StorageFor<T>>();
         }
-        return *static_cast<ComponentStorage<T>*>(storages[type].get());
+        return *static_cast<StorageFor<T>*>(storages[type].get());
     }
 
     RenderingQueues renderingQueues;
 
+    // Component events are only recorded for types that have an observer.
+    struct ObserverList {
+        ComponentBitMask observed;
+        std::array<std::vector<Observer>, COMPONENT_COUNT> observers;
+        std::array<std::vector<EntityID>, COMPONENT_COUNT> pending;
+        std::vector<EntityID> batch;
+
+        void record(size_t typeIndex, EntityID id) {
+            if (observed.test(typeIndex)) pending[typeIndex].push_back(id);
+        }
+    };
+    ObserverList onAddObservers;
+    ObserverList onSetObservers;
+    ObserverList onRemoveObservers;
+
+    bool dispatch(ObserverList& list);
+
+    struct Prefab {
+        std::function<void(ECS&, EntityID)> build;
+        std::vector<EntityID> pool;  // despawned entities waiting for reuse
+    };
+    std::vector<Prefab> prefabs;
+
+    struct MemoryBudget {
+        size_t bytes;
+        bool exceeded = false;
+    };
+    std::unordered_map<std::string, size_t> memoryHighWater;
+    std::unordered_map<std::string, MemoryBudget> memoryBudgets;
+
+    void trackMemory(MemoryStats& stats);
+
+    template<typename T>
+    ECS& observe(ObserverList& list, Observer fn) {
+        constexpr auto typeIndex = static_cast<size_t>(ComponentToType<T>::index);
+        list.observed.set(typeIndex, true);
+        list.observers[typeIndex].push_back(std::move(fn));
+        return *this;
+    }
+
 public:
     EntityStorage entityStorage{};
+    ContactBuffer contacts{};
+    // Contacts carried across ticks, brought up to date by the colliding systems.
+    ContactPairCache contactPairs{};
+    CommandBuffer commands{};
+    // Advanced once per update(), fired actions are applied before the first stage.
+    TimerWheel timers{};
 
     EntityID createEntity();
     void removeEntity(EntityID id);
+
+    // `build` runs on every spawn of the prefab. It should use setComponent()
+    // so a recycled entity only has its values rewritten.
+    PrefabID registerPrefab(std::function<void(ECS&, EntityID)> build);
+
+    // Reactivates a despawned entity of `prefab`, or creates one when its pool
+    // is empty. Observers only see component events for newly created ones.
+    EntityID spawn(PrefabID prefab);
+
+    // Parks a pooled entity in its prefab's pool with its components in place
+    // and cancels its PooledComponent timer. Other entities are removed.
+    void despawn(EntityID id);
     ECS& nextStage(StageType type);
     ECS& addSystem(std::function<void(ECS&, const float&, RenderingQueues&)> fn);
     void update(const float& deltaTime);
 
+    // Declares the resources the last added system touches. Systems of a
+    // parallel stage whose declarations conflict run one after another.
+    // Declaring a resource also creates it, so a parallel stage finds every
+    // resource it declared already in place.
+    template<typename... T>
+    ECS& reads() {
+        ((lastSystem().access.reads.push_back(resourceId<T>()), resource<T>()), ...);
+        return *this;
+    }
+
+    template<typename... T>
+    ECS& writes() {
+        ((lastSystem().access.writes.push_back(resourceId<T>()), resource<T>()), ...);
+        return *this;
+    }
+
+    // Rate of the last added system. It runs on every n-th tick, or once at
+    // least 1/hz seconds of ticks have accumulated, and receives the delta
+    // time summed since its previous run.
+    ECS& every(unsigned ticks);
+    ECS& atRate(float hz);
+
+    // Caps the time the last added system should spend per run. The system
+    // walks its query through budgetedSlice(), which sizes each slice from
+    // the measured cost per entity.
+    ECS& withBudget(float seconds);
+
+    // Next round-robin slice of `entities` for the running system. A walk
+    // covers a snapshot of the query and resumes where the previous run
+    // stopped; entities may have lost components since the snapshot. Systems
+    // without a budget, or called outside update(), get the whole query.
+    template<typename Range>
+    std::span<const EntityID> budgetedSlice(const Range& entities) {
+        return budgetedSlice(entities, [](EntityID) { return true; });
+    }
+
+    // As above, but only hands out entities for which `ready(entity)` holds.
+    // The others stay in the walk for a later run instead of being passed
+    // over, so an entity that is ready only on some ticks, such as a far LOD
+    // tier, is still visited once per walk. `ready` must eventually hold for
+    // every entity of the snapshot, including ones that left the query. A run
+    // tests at most ready_scan_factor entities per entity it may hand out and
+    // the next run resumes testing where this one stopped, so sparse
+    // readiness costs no more than the budget allows.
+    template<typename Range, typename Ready>
+    std::span<const EntityID> budgetedSlice(const Range& entities, Ready&& ready) {
+        auto& slice = runningSystem != nullptr ? runningSystem->slice : unscheduledSlice;
+        if (slice.cursor >= slice.entities.size()) {
+            slice.entities.assign(entities.begin(), entities.end());
+            slice.cursor = 0;
+            slice.scan = 0;
+        }
+        size_t count = slice.entities.size() - slice.cursor;
+        const float budget = runningSystem != nullptr ? runningSystem->schedule.budget : 0.0f;
+        if (budget > 0.0f && slice.secondsPerEntity > 0.0f) {
+            count = std::min(count, std::max<size_t>(1, static_cast<size_t>(budget / slice.secondsPerEntity)));
+        }
+        // Ready entities are swapped up to the cursor, the rest stay behind it.
+        // Testing wraps around once to the entities skipped earlier.
+        size_t taken = 0;
+        size_t tests = 0;
+        size_t k = std::max(slice.scan, slice.cursor);
+        bool wrapped = k == slice.cursor;
+        while (taken < count && tests < ready_scan_factor * count) {
+            if (k == slice.entities.size()) {
+                if (wrapped) break;
+                wrapped = true;
+                k = slice.cursor + taken;
+                continue;
+            }
+            ++tests;
+            if (ready(slice.entities[k])) {
+                std::swap(slice.entities[slice.cursor + taken], slice.entities[k]);
+                ++taken;
+            }
+            ++k;
+        }
+        std::span<const EntityID> result(slice.entities.data() + slice.cursor, taken);
+        slice.cursor += taken;
+        slice.scan = k;
+        slice.handedOut += taken;
+        return result;
+    }
+
+    // World-global singleton, default constructed on first access. Lives
+    // outside entity storage and is found by a per-type index. Creating one
+    // inside a parallel stage would race with the other systems, so it
+    // throws there; declare the resource with reads() or writes() instead.
+    template<typename T>
+    T& resource() {
+        const auto id = resourceId<T>();
+        if (id >= resources.size() || !resources[id]) {
+            if (parallelStageRunning) {
+                throw std::runtime_error("Resource created inside a parallel stage. Declare it with reads() or writes().");
+            }
+        }
+        if (id >= resources.size()) {
+            resources.resize(id + 1);
+        }
+        if (!resources[id]) {
+            resources[id] = std::make_shared<T>();
+        }
+        return *static_cast<T*>(resources[id].get());
+    }
+
+    // Render systems run once per frame after the fixed ticks. They receive
+    // the interpolation factor between the previous and current tick instead
+    // of a delta time, and write into the given queues.
+    ECS& addRenderSystem(std::function<void(ECS&, const float&, RenderingQueues&)> fn);
+    void render(const float& alpha, RenderingQueues& queues);
+
+    // Applies recorded commands and hands every observer the entities that
+    // changed since the last flush, one batch per component type. Runs after
+    // each stage of update().
+    void flush();
+
+    // Collects per-storage and per-query memory use and updates the high-water
+    // marks. Walks every storage and query, so sample it every few ticks
+    // rather than every frame.
+    MemoryReport memoryReport();
+
+    // Soft budget on the capacity of one report entry, matched by name. A
+    // component storage is named after its component, "total" covers the
+    // whole report. Exceeding it is logged once until usage falls back under.
+    ECS& setMemoryBudget(const std::string& name, size_t bytes);
+
+    template<typename T>
+    ECS& setMemoryBudget(size_t bytes) { return setMemoryBudget(componentName<T>(), bytes); }
+
+    template<typename T>
+    ECS& onAdd(Observer fn) { return observe<T>(onAddObservers, std::move(fn)); }
+
+    template<typename T>
+    ECS& onSet(Observer fn) { return observe<T>(onSetObservers, std::move(fn)); }
+
+    // Removed entities may no longer exist when the batch is delivered.
+    template<typename T>
+    ECS& onRemove(Observer fn) { return observe<T>(onRemoveObservers, std::move(fn)); }
+
     template<typename T>
     void removeComponent(EntityID id) {
         if (!entityStorage.hasComponent<T>(id)) return;
         getStorage<T>().removeComponent(id, entityStorage);
         entityStorage.removeComponent<T>(id);
+        onRemoveObservers.record(static_cast<size_t>(ComponentToType<T>::index), id);
     }
 
     template<typename T>
@@ -70,6 +339,25 @@ public:
         return getStorage<T>().getByIndex(indexInStorage);
     }
 
+    // Moves the entity's T into `slot`, the component living there takes the
+    // entity's old slot. Fails if `slot` is free. Pointers to both components
+    // are invalidated, which paged storages rule out.
+    template<typename T>
+    bool moveComponentToSlot(EntityID entity, size_t slot) {
+        static_assert(!UsePagedStorage<T>::value, "Paged components keep their address and cannot be moved.");
+        auto& storage = getStorage<T>();
+        const auto current = entityStorage.getComponentIndex<T>(entity);
+        if (current == std::numeric_limits<size_t>::max() || storage.getByIndex(slot) == nullptr) {
+            return false;
+        }
+        if (current == slot) return true;
+        const auto displaced = storage.entityAt(slot);
+        storage.swapSlots(current, slot);
+        entityStorage.setComponentIndex<T>(entity, slot);
+        entityStorage.setComponentIndex<T>(displaced, current);
+        return true;
+    }
+
     template<typename T>
     QueryBuilder getEntitiesWithComponent() {
         QueryBuilder qb(entityStorage);
@@ -82,5 +370,51 @@ public:
         if (entityStorage.hasComponent<T>(entity)) return;
         auto component_index = getStorage<T>().add(entity, component);
         entityStorage.addComponent<T>(entity, component_index);
+        onAddObservers.record(static_cast<size_t>(ComponentToType<T>::index), entity);
+    }
+
+    // Stores `value` once for all entities that share it, see Shared<T>. Like
+    // addComponent(), it does nothing if the entity already has one.
+    template<typename T>
+    void addSharedComponent(EntityID entity, const T& value) {
+        addComponent(entity, Shared<T>{getStorage<Shared<T>>().intern(value)});
+    }
+
+    // Adds or replaces the entity's shared value, moving it to the group of
+    // the new value.
+    template<typename T>
+    void setSharedComponent(EntityID entity, const T& value) {
+        setComponent(entity, Shared<T>{getStorage<Shared<T>>().intern(value)});
+    }
+
+    template<typename T>
+    const T* getSharedComponent(EntityID id) {
+        auto* shared = getComponent<Shared<T>>(id);
+        if (shared == nullptr) {
+            return nullptr;
+        }
+        return &getStorage<Shared<T>>().value(shared->handle);
+    }
+
+    // Every distinct shared value with the entities currently using it.
+    template<typename T>
+    const auto& getSharedGroups() {
+        return getStorage<Shared<T>>().getGroups();
+    }
+
+    template<typename T>
+    void setComponent(EntityID entity, const T& component) {
+        auto* current = getComponent<T>(entity);
+        if (current == nullptr) {
+            addComponent(entity, component);
+            return;
+        }
+        if constexpr (IsShared<T>::value) {
+            // The handle decides the entity's group, the storage keeps both in step.
+            getStorage<T>().set(entity, component, entityStorage);
+        } else {
+            *current = component;
+        }
+        onSetObservers.record(static_cast<size_t>(ComponentToType<T>::index), entity);
     }
 };
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// What the collision broadphase saw in its last pass, kept instead of
+// logging so entities far from the origin cost nothing extra.
+struct BroadphaseStats {
+    float minX = 0.0f, minY = 0.0f;  // bounds of the proxies
+    float maxX = 0.0f, maxY = 0.0f;
+    float rootHalfSize = 0.0f;       // half the root cell of tree broadphases
+    size_t proxies = 0;
+    size_t relocated = 0;            // entities moved to another node
+    size_t nonFinite = 0;            // proxies left out for a NaN or infinite position
+    uint64_t rootGrowths = 0;        // since the broadphase was created
+};
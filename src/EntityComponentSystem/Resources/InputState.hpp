@@ -0,0 +1,30 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "../../InputHandler/InputHandler.hpp"
+
+// Keyboard as seen by the simulation, sampled from gInputHandler once per
+// tick by the simulation thread. A press since the previous sample reads as
+// clicked, and as pressed even if the key was let go again before the tick.
+struct InputState {
+    static constexpr size_t key_count = static_cast<size_t>(Key::COUNT);
+
+    std::array<bool, key_count> pressed{};
+    std::array<bool, key_count> clicked{};
+    std::array<uint32_t, key_count> seenPresses{};  // press counts at the previous sample
+
+    void sample(const InputHandler& input) {
+        for (size_t k = 0; k < key_count; ++k) {
+            const auto key = static_cast<Key>(k);
+            const uint32_t presses = input.pressCount(key);
+            clicked[k] = presses != seenPresses[k];
+            seenPresses[k] = presses;
+            pressed[k] = clicked[k] || input.isPressed(key);
+        }
+    }
+
+    bool isPressed(Key key) const { return pressed[static_cast<size_t>(key)]; }
+    bool isClicked(Key key) const { return clicked[static_cast<size_t>(key)]; }
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+using EntityID = std::size_t;
+
+// The single player entity and its position as of the start of the tick,
+// refreshed by playerStateSystem.
+struct PlayerState {
+    EntityID entity = 0;
+    bool alive = false;
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+};
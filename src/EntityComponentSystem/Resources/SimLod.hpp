@@ -0,0 +1,12 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Distance tiers of the simulation level of detail. Near matches the
+// rendering cull distance so everything on screen simulates every tick.
+struct SimLod {
+    std::array<float, 2> tierDistances{50.0f, 100.0f};  // upper bounds of near and mid
+    std::array<uint32_t, 3> tierIntervals{1, 4, 16};    // ticks between updates per tier
+    uint64_t tick = 0;
+};
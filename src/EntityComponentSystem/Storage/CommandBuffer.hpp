@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+using EntityID = std::size_t;
+
+class ECS;
+
+// Structural changes recorded by systems and applied by ECS::flush() once the
+// current stage has finished, so no query set is mutated while iterated.
+class CommandBuffer {
+private:
+    std::vector<std::function<void(ECS&)>> commands;
+
+public:
+    template<typename T>
+    void addComponent(EntityID id, const T& component) {
+        commands.emplace_back([id, component](auto& ecs) { ecs.addComponent(id, component); });
+    }
+
+    template<typename T>
+    void removeComponent(EntityID id) {
+        commands.emplace_back([id](auto& ecs) { ecs.template removeComponent<T>(id); });
+    }
+
+    void removeEntity(EntityID id);
+
+    void push(std::function<void(ECS&)> command) {
+        commands.push_back(std::move(command));
+    }
+
+    bool empty() const { return commands.empty(); }
+
+    void apply(ECS& ecs) {
+        // Commands may record further commands, those run on the next apply.
+        auto pending = std::move(commands);
+        commands.clear();
+        for (auto& command : pending) {
+            command(ecs);
+        }
+    }
+};
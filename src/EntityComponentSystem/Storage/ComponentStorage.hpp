@@ -3,9 +3,11 @@
 #include <cstddef>
 #include <memory>
 #include <queue>
+#include <utility>
 #include <vector>
 
 #include "EntityStorage.hpp"
+#include "MemoryStats.hpp"
 
 using EntityID = std::size_t;
 
@@ -14,6 +16,7 @@ public:
     virtual ~IStorage() = default;
     virtual void removeEntity(EntityID id, EntityStorage& es) = 0;
     virtual void removeComponent(EntityID id, EntityStorage& es) = 0;
+    virtual MemoryStats memoryStats() const = 0;
 };
 
 enum class CellState {
@@ -35,6 +38,7 @@ public:
     std::vector<T> components;
     std::vector<Cell> entityIDs;
     size_t firstFreeCell = npos;
+    size_t freeCount = 0;
 
     ComponentStorage() {
         components.reserve(initial_reserve_size);
@@ -52,6 +56,7 @@ public:
         entityIDs[currentIndex]  = {CellState::Occupied, id};
         components[currentIndex] = component;
         firstFreeCell = nextFreeCell;
+        --freeCount;
         return currentIndex;
     }
 
@@ -67,12 +72,32 @@ public:
         auto componentIndex = es.getComponentIndex<T>(id);
         entityIDs[componentIndex] = { CellState::Free, firstFreeCell};
         firstFreeCell = componentIndex;
+        ++freeCount;
     }
 
     void removeComponent(EntityID id, EntityStorage& es) override {
         auto componentIndex = es.getComponentIndex<T>(id);
         entityIDs[componentIndex] = { CellState::Free, firstFreeCell};
         firstFreeCell = componentIndex;
+        ++freeCount;
+    }
+
+    EntityID entityAt(size_t index) const { return entityIDs[index].entityId; }
+
+    // Exchanges two occupied slots. The caller updates the entities' indices.
+    void swapSlots(size_t a, size_t b) {
+        std::swap(components[a], components[b]);
+        std::swap(entityIDs[a], entityIDs[b]);
+    }
+
+    MemoryStats memoryStats() const override {
+        MemoryStats stats{componentName<T>()};
+        stats.liveBytes = (entityIDs.size() - freeCount) * (sizeof(T) + sizeof(Cell));
+        stats.capacityBytes = components.capacity() * sizeof(T) + entityIDs.capacity() * sizeof(Cell);
+        if (!entityIDs.empty()) {
+            stats.fragmentation = static_cast<float>(freeCount) / static_cast<float>(entityIDs.size());
+        }
+        return stats;
     }
 
     std::vector<T>& getAll() { return components; }
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "MemoryStats.hpp"
+
+using EntityID = std::size_t;
+
+// Single overlap reported by the colliding system. Always stored with a < b,
+// the normal points from a towards b.
+struct Contact {
+    EntityID a;
+    EntityID b;
+    float nx;
+    float ny;
+    float depth;
+};
+
+// Per-frame stream of contacts. Cleared at the start of every collision pass,
+// the backing vector keeps its capacity so steady state emits do not allocate.
+class ContactBuffer {
+private:
+    static constexpr size_t initial_reserve_size = 1024;
+    std::vector<Contact> contacts;
+
+public:
+    ContactBuffer() {
+        contacts.reserve(initial_reserve_size);
+    }
+
+    void clear() { contacts.clear(); }
+
+    void emit(EntityID a, EntityID b, float nx, float ny, float depth) {
+        if (b < a) {
+            contacts.push_back({b, a, -nx, -ny, depth});
+            return;
+        }
+        contacts.push_back({a, b, nx, ny, depth});
+    }
+
+    // Groups contacts by their first entity so consumers touch each entity's
+    // components in one run.
+    void sortByEntity() {
+        std::sort(contacts.begin(), contacts.end(), [](const Contact& lhs, const Contact& rhs) {
+            return lhs.a != rhs.a ? lhs.a < rhs.a : lhs.b < rhs.b;
+        });
+    }
+
+    MemoryStats memoryStats() const {
+        return {"ContactBuffer", contacts.size() * sizeof(Contact),
+                contacts.capacity() * sizeof(Contact)};
+    }
+
+    size_t size() const { return contacts.size(); }
+    const std::vector<Contact>& getAll() const { return contacts; }
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "ContactBuffer.hpp"
+#include "MemoryStats.hpp"
+
+// A touching pair as remembered across ticks, keyed by a < b.
+struct ContactPair {
+    EntityID a;
+    EntityID b;
+    uint32_t age;            // ticks since the contact began, 0 on its first tick
+    uint32_t lastSeen;       // update() pass that last kept the pair
+    float push;              // push applied to each side on its last resolved tick
+    float accumulatedPush;   // push applied to each side since the contact began
+};
+
+// Contacts that persist between ticks, in an open-addressing table with
+// linear probing. update() matches every tick's contacts against it and
+// reports which pairs began and which ended, so gameplay can react to a touch
+// once and resolution can warm start from last tick's push. Erasing shifts
+// the following run back instead of leaving tombstones.
+class ContactPairCache {
+private:
+    static constexpr size_t initial_capacity = 1024;  // power of two
+    static constexpr EntityID empty = std::numeric_limits<EntityID>::max();
+
+    std::vector<ContactPair> slots;
+    std::vector<std::pair<EntityID, EntityID>> beganPairs;
+    std::vector<std::pair<EntityID, EntityID>> endedPairs;
+    size_t count = 0;
+    uint32_t pass = 0;
+
+    size_t mask() const { return slots.size() - 1; }
+
+    static size_t hash(EntityID a, EntityID b) {
+        uint64_t h = static_cast<uint64_t>(a) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(b);
+        h ^= h >> 31;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 29;
+        return static_cast<size_t>(h);
+    }
+
+    size_t slotOf(EntityID a, EntityID b) const {
+        size_t slot = hash(a, b) & mask();
+        while (slots[slot].a != empty && (slots[slot].a != a || slots[slot].b != b)) {
+            slot = (slot + 1) & mask();
+        }
+        return slot;
+    }
+
+    // Keeps the load at or below one half.
+    void reserveFor(size_t pairs) {
+        if (pairs * 2 <= slots.size()) return;
+        size_t capacity = slots.size();
+        while (pairs * 2 > capacity) capacity *= 2;
+
+        std::vector<ContactPair> old(capacity, ContactPair{empty, empty, 0, 0, 0.0f, 0.0f});
+        std::swap(slots, old);
+        for (const auto& pair : old) {
+            if (pair.a != empty) slots[slotOf(pair.a, pair.b)] = pair;
+        }
+    }
+
+    void erase(EntityID a, EntityID b) {
+        size_t hole = slotOf(a, b);
+        if (slots[hole].a == empty) return;
+        --count;
+        // Moves back every later entry of the run whose home slot does not
+        // lie between the hole and itself.
+        for (size_t next = (hole + 1) & mask(); slots[next].a != empty; next = (next + 1) & mask()) {
+            const size_t home = hash(slots[next].a, slots[next].b) & mask();
+            if (((next - home) & mask()) < ((next - hole) & mask())) continue;
+            slots[hole] = slots[next];
+            hole = next;
+        }
+        slots[hole].a = empty;
+    }
+
+public:
+    ContactPairCache() : slots(initial_capacity, ContactPair{empty, empty, 0, 0, 0.0f, 0.0f}) {}
+
+    // Matches this tick's contacts against the cached pairs. A pair missing
+    // from `contacts` ends unless `retain(a, b)` says it was not looked for.
+    template<typename Retain>
+    void update(const ContactBuffer& contacts, Retain&& retain) {
+        ++pass;
+        beganPairs.clear();
+        endedPairs.clear();
+        reserveFor(count + contacts.size());
+
+        for (const auto& contact : contacts.getAll()) {
+            auto& pair = slots[slotOf(contact.a, contact.b)];
+            if (pair.a == empty) {
+                pair = {contact.a, contact.b, 0, pass, 0.0f, 0.0f};
+                beganPairs.emplace_back(contact.a, contact.b);
+                ++count;
+                continue;
+            }
+            if (pair.lastSeen == pass) continue;
+            ++pair.age;
+            pair.lastSeen = pass;
+        }
+
+        for (auto& pair : slots) {
+            if (pair.a == empty || pair.lastSeen == pass) continue;
+            if (retain(pair.a, pair.b)) {
+                pair.lastSeen = pass;
+                continue;
+            }
+            endedPairs.emplace_back(pair.a, pair.b);
+        }
+        for (const auto& [a, b] : endedPairs) erase(a, b);
+    }
+
+    // Pair of `a` and `b` in either order, nullptr when they do not touch.
+    ContactPair* find(EntityID a, EntityID b) {
+        if (b < a) std::swap(a, b);
+        auto& pair = slots[slotOf(a, b)];
+        return pair.a == empty ? nullptr : &pair;
+    }
+
+    const ContactPair* find(EntityID a, EntityID b) const {
+        return const_cast<ContactPairCache*>(this)->find(a, b);
+    }
+
+    // Pairs that started and stopped touching in the last update().
+    const std::vector<std::pair<EntityID, EntityID>>& began() const { return beganPairs; }
+    const std::vector<std::pair<EntityID, EntityID>>& ended() const { return endedPairs; }
+
+    MemoryStats memoryStats() const {
+        const size_t eventBytes = sizeof(std::pair<EntityID, EntityID>);
+        return {"ContactPairCache",
+                count * sizeof(ContactPair) + (beganPairs.size() + endedPairs.size()) * eventBytes,
+                slots.capacity() * sizeof(ContactPair) +
+                    (beganPairs.capacity() + endedPairs.capacity()) * eventBytes};
+    }
+
+    size_t size() const { return count; }
+};
@@ -1,22 +1,27 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <bitset>
 #include <cstddef>
 #include <optional>
+#include <ranges>
 #include <stdexcept>
+#include <string>
 #include <typeindex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "../Components/ComponentIndexes.hpp"
+#include "MemoryStats.hpp"
 
 using EntityID = std::size_t;
 using ComponentBitMask = std::bitset<COMPONENT_COUNT>;
 
 struct EntityData {
     ComponentBitMask componentMask;  // Which components the entity has
+    bool active = true;              // Inactive entities are left out of every query
     std::array<std::optional<size_t>, COMPONENT_COUNT>
         componentIndices;  // Component index inside its storage
 };
@@ -25,37 +30,144 @@ inline bool is_subset(const ComponentBitMask& a, const ComponentBitMask& b) {
     return (a & b) == a;
 }
 
+template<typename T>
+bool maskHas(const ComponentBitMask& mask) {
+    return mask.test(static_cast<size_t>(ComponentToType<T>::index));
+}
+
+// Terms of a cached query, all evaluated on the entity's component mask.
+struct QueryKey {
+    ComponentBitMask all;       // andHas<T>()
+    ComponentBitMask none;      // without<T>()
+    ComponentBitMask any;       // anyOf<T...>()
+    ComponentBitMask optional;  // optional<T>()
+
+    bool operator==(const QueryKey&) const = default;
+
+    bool matches(const ComponentBitMask& mask) const {
+        return is_subset(all, mask) && (mask & none).none() &&
+               (any.none() || (mask & any).any());
+    }
+};
+
+// Readable form of a query's terms, e.g. "PositionComponent,!RemoveComponent".
+inline std::string describeQuery(const QueryKey& key) {
+    std::string text;
+    auto append = [&](const ComponentBitMask& mask, const char* prefix) {
+        for (size_t typeIndex = 0; typeIndex < COMPONENT_COUNT; ++typeIndex) {
+            if (!mask.test(typeIndex)) continue;
+            if (!text.empty()) text += ',';
+            text += prefix;
+            text += COMPONENT_NAMES[typeIndex];
+        }
+    };
+    append(key.all, "");
+    append(key.none, "!");
+    append(key.any, "|");
+    append(key.optional, "?");
+    return text;
+}
+
+struct QueryKeyHash {
+    size_t operator()(const QueryKey& key) const {
+        std::hash<ComponentBitMask> hash;
+        size_t seed = hash(key.all);
+        for (const auto& mask : {key.none, key.any, key.optional}) {
+            seed ^= hash(mask) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+};
+
+struct CachedQuery {
+    std::unordered_set<EntityID> entities;
+    // Optional components present on each match, only kept for queries with
+    // optional terms.
+    std::unordered_map<EntityID, ComponentBitMask> optionalMasks;
+};
+
 class EntityStorage {
 private:
     std::unordered_map<EntityID, EntityData> entities;
-    std::unordered_map<ComponentBitMask, std::unordered_set<EntityID>> components;
+    std::unordered_map<QueryKey, CachedQuery, QueryKeyHash> queries;
+    size_t inactiveCount = 0;
+
+    // Moves `id` in or out of every cached query after its mask changed.
+    void refreshQueries(EntityID id, const std::optional<ComponentBitMask>& maskBefore,
+                        const EntityData& data) {
+        if (!data.active) return;
+        const auto& maskAfter = data.componentMask;
+        for (auto& [key, cached] : queries) {
+            const bool before = maskBefore.has_value() && key.matches(*maskBefore);
+            const bool after = key.matches(maskAfter);
+            if (before && !after) {
+                cached.entities.erase(id);
+                cached.optionalMasks.erase(id);
+            }
+            if (after) {
+                cached.entities.insert(id);
+                if (key.optional.any()) cached.optionalMasks[id] = maskAfter & key.optional;
+            }
+        }
+    }
 
 public:
     void addEntity(EntityID id) {
         if (entities.find(id) != entities.end()) {
             throw std::runtime_error("Entity already exists!");
         }
-        entities[id] = EntityData{};
+        const auto& data = entities[id] = EntityData{};
+        refreshQueries(id, std::nullopt, data);
     }
 
-    const std::unordered_set<EntityID>& query(const ComponentBitMask& bitMask) {
-        auto result = components.find(bitMask);
-        if (result == components.end()) {
-            std::unordered_set<EntityID> set;
+    const CachedQuery& query(const QueryKey& key) {
+        auto result = queries.find(key);
+        if (result == queries.end()) {
+            CachedQuery cached;
             for (auto& [entityId, entityData] : entities) {
-                if (is_subset(bitMask, entityData.componentMask)) {
-                    set.insert(entityId);
+                if (entityData.active && key.matches(entityData.componentMask)) {
+                    cached.entities.insert(entityId);
+                    if (key.optional.any()) {
+                        cached.optionalMasks[entityId] = entityData.componentMask & key.optional;
+                    }
                 }
             }
-            components[bitMask] = set;
+            result = queries.emplace(key, std::move(cached)).first;
         }
-        return components[bitMask];
+        return result->second;
+    }
+
+    // Parks an entity outside of every query while keeping its components,
+    // used by entity pools.
+    void setActive(EntityID id, bool active) {
+        auto& data = entities.at(id);
+        if (data.active == active) return;
+        if (active) {
+            data.active = true;
+            --inactiveCount;
+            refreshQueries(id, std::nullopt, data);
+            return;
+        }
+        for (auto& cached : queries | std::views::values) {
+            cached.entities.erase(id);
+            cached.optionalMasks.erase(id);
+        }
+        data.active = false;
+        ++inactiveCount;
+    }
+
+    bool isActive(EntityID id) const {
+        auto it = entities.find(id);
+        return it != entities.end() && it->second.active;
     }
 
     void removeEntity(EntityID id) {
+        auto it = entities.find(id);
+        if (it != entities.end() && !it->second.active) --inactiveCount;
         entities.erase(id);
-        for (auto& ids : components | std::views::values) {
-            ids.erase(id);
+        for (auto& cached : queries | std::views::values) {
+            cached.entities.erase(id);
+            cached.optionalMasks.erase(id);
         }
     }
 
@@ -68,15 +180,11 @@ public:
 
         constexpr auto typeIndex = static_cast<size_t>(ComponentToType<T>::index);
 
+        const auto maskBefore = it->second.componentMask;
         it->second.componentMask.set(typeIndex, true);
         it->second.componentIndices[typeIndex] = componentIndex;
 
-        const auto entityBitMaks = it->second.componentMask;
-        for (auto& [bitmask, ids] : components) {
-            if (is_subset(bitmask, entityBitMaks)) {
-                ids.insert(id);
-            }
-        }
+        refreshQueries(id, maskBefore, it->second);
     }
 
     template<typename T>
@@ -96,12 +204,7 @@ public:
             throw std::runtime_error("Entity does not exist!");
         }
 
-        const auto entityBitMaks = it->second.componentMask;
-        for (auto& [bitmask, ids] : components) {
-            if (is_subset(bitmask, entityBitMaks)) {
-                ids.insert(id);
-            }
-        }
+        refreshQueries(id, ComponentBitMask{}, it->second);
     }
 
     template<typename T>
@@ -114,16 +217,7 @@ public:
         const auto maskBefore = it->second.componentMask;
         it->second.componentMask.set(typeIndex, false);
         it->second.componentIndices[typeIndex].reset();
-        const auto maskAfter = it->second.componentMask;
-
-        for (auto& [bitmask, ids] : components) {
-            if (is_subset(bitmask, maskBefore)) {
-                ids.erase(id);
-            }
-            if (is_subset(bitmask, maskAfter)) {
-                ids.insert(id);
-            }
-        }
+        refreshQueries(id, maskBefore, it->second);
     }
 
     bool hasEntity(EntityID id) const {
@@ -139,6 +233,13 @@ public:
         return it->second.componentMask.test(typeIndex);
     }
 
+    const ComponentBitMask& getComponentMask(EntityID id) const {
+        static const ComponentBitMask empty{};
+        auto it = entities.find(id);
+        if (it == entities.end()) return empty;
+        return it->second.componentMask;
+    }
+
     template<typename T>
     size_t getComponentIndex(EntityID id) const {
         auto it = entities.find(id);
@@ -154,6 +255,41 @@ public:
         return optIndex.value();
     }
 
+    // One entry for the entity table and one per cached query. Hash container
+    // sizes are estimates, node allocator overhead is not visible from here.
+    MemoryStats memoryStats() const {
+        MemoryStats stats{"EntityStorage"};
+        stats.liveBytes = entities.size() * sizeof(std::pair<const EntityID, EntityData>);
+        stats.capacityBytes = hashContainerBytes(entities) + hashContainerBytes(queries);
+        return stats;
+    }
+
+    std::vector<MemoryStats> queryMemoryStats() const {
+        std::vector<MemoryStats> stats;
+        stats.reserve(queries.size());
+        for (const auto& [key, cached] : queries) {
+            MemoryStats& query = stats.emplace_back(MemoryStats{"query " + describeQuery(key)});
+            query.liveBytes = cached.entities.size() * sizeof(EntityID) +
+                              cached.optionalMasks.size() * sizeof(ComponentBitMask);
+            query.capacityBytes = hashContainerBytes(cached.entities) +
+                                  hashContainerBytes(cached.optionalMasks);
+            // Empty buckets left behind after the query shrank.
+            const size_t buckets = cached.entities.bucket_count();
+            if (buckets != 0) {
+                query.fragmentation =
+                    1.0f - static_cast<float>(std::min(cached.entities.size(), buckets)) /
+                               static_cast<float>(buckets);
+            }
+        }
+        return stats;
+    }
+
+    template<typename T>
+    void setComponentIndex(EntityID id, size_t componentIndex) {
+        constexpr auto typeIndex = static_cast<size_t>(ComponentToType<T>::index);
+        entities.at(id).componentIndices[typeIndex] = componentIndex;
+    }
+
     std::vector<EntityID> getAllEntities() const {
         std::vector<EntityID> ids;
         ids.reserve(entities.size());
@@ -167,6 +303,10 @@ public:
         return entities.size();
     }
 
+    size_t getNumberOfActiveEntities() const {
+        return entities.size() - inactiveCount;
+    }
+
     template<typename T>
     friend class ComponentStorage;
 };
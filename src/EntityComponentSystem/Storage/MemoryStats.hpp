@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct MemoryStats {
+    std::string name;
+    size_t liveBytes = 0;      // bytes held by live elements
+    size_t capacityBytes = 0;  // bytes allocated, including free-list holes and reserve
+    size_t highWaterBytes = 0; // largest capacityBytes seen by ECS::memoryReport()
+    float fragmentation = 0.0f; // share of handed-out slots sitting on the free list
+};
+
+struct MemoryReport {
+    std::vector<MemoryStats> storages;
+    std::vector<MemoryStats> queries;
+    size_t liveBytes = 0;
+    size_t capacityBytes = 0;
+    size_t highWaterBytes = 0;
+};
+
+// Approximate footprint of a node-based unordered container: the bucket array
+// plus one node (next pointer and value) per element.
+template<typename Container>
+size_t hashContainerBytes(const Container& container) {
+    return container.bucket_count() * sizeof(void*) +
+           container.size() * (sizeof(void*) + sizeof(typename Container::value_type));
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ComponentStorage.hpp"
+
+// Components live in fixed-size pages that are never moved, so pointers
+// returned by ECS::getComponent stay valid while other entities are added or
+// removed, and growing past the current capacity allocates one page instead
+// of copying. A component keeps its address until it is removed; there is no
+// swapSlots(), so maintenance passes such as MortonReorderSystem cannot move
+// these types.
+template<typename T, size_t PageSize = 512>
+class PagedComponentStorage : public IStorage {
+private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    struct Page {
+        Cell cells[PageSize];
+        alignas(T) std::byte data[sizeof(T) * PageSize];
+
+        T* at(size_t slot) { return std::launder(reinterpret_cast<T*>(data) + slot); }
+    };
+
+    std::vector<std::unique_ptr<Page>> pages;
+    size_t slotCount = 0;
+    size_t firstFreeCell = npos;
+    size_t freeCount = 0;
+
+    Cell& cell(size_t index) { return pages[index / PageSize]->cells[index % PageSize]; }
+    T* slot(size_t index) { return pages[index / PageSize]->at(index % PageSize); }
+
+    void release(size_t index) {
+        std::destroy_at(slot(index));
+        cell(index) = {CellState::Free, firstFreeCell};
+        firstFreeCell = index;
+        ++freeCount;
+    }
+
+public:
+    PagedComponentStorage() = default;
+    PagedComponentStorage(const PagedComponentStorage&) = delete;
+    PagedComponentStorage& operator=(const PagedComponentStorage&) = delete;
+
+    ~PagedComponentStorage() override {
+        for (size_t index = 0; index < slotCount; ++index) {
+            if (cell(index).state == CellState::Occupied) std::destroy_at(slot(index));
+        }
+    }
+
+    size_t add(EntityID id, const T& component) {
+        size_t index = firstFreeCell;
+        if (index == npos) {
+            index = slotCount++;
+            if (index / PageSize == pages.size()) {
+                pages.push_back(std::make_unique<Page>());
+            }
+        } else {
+            firstFreeCell = cell(index).entityId;
+            --freeCount;
+        }
+        std::construct_at(slot(index), component);
+        cell(index) = {CellState::Occupied, id};
+        return index;
+    }
+
+    T* getByIndex(size_t index) {
+        if (cell(index).state == CellState::Free) {
+            return nullptr;
+        }
+        return slot(index);
+    }
+
+    void removeEntity(EntityID id, EntityStorage& es) override {
+        if (!es.hasComponent<T>(id)) return;
+        release(es.getComponentIndex<T>(id));
+    }
+
+    void removeComponent(EntityID id, EntityStorage& es) override {
+        release(es.getComponentIndex<T>(id));
+    }
+
+    EntityID entityAt(size_t index) const {
+        return pages[index / PageSize]->cells[index % PageSize].entityId;
+    }
+
+    MemoryStats memoryStats() const override {
+        MemoryStats stats{componentName<T>()};
+        stats.liveBytes = (slotCount - freeCount) * (sizeof(T) + sizeof(Cell));
+        stats.capacityBytes = pages.size() * sizeof(Page) + pages.capacity() * sizeof(pages[0]);
+        if (slotCount != 0) {
+            stats.fragmentation = static_cast<float>(freeCount) / static_cast<float>(slotCount);
+        }
+        return stats;
+    }
+};
+
+// Components whose pointers are held across entity creation within a tick,
+// or that spawn in large waves, opt into paged storage. Everything else keeps
+// the dense vector backend.
+template<typename T>
+struct UsePagedStorage : std::false_type {};
+
+template<>
+struct UsePagedStorage<PositionComponent> : std::true_type {};
+
+template<>
+struct UsePagedStorage<PreviousPositionComponent> : std::true_type {};
+
+template<>
+struct UsePagedStorage<MovableComponent> : std::true_type {};
+
+template<>
+struct UsePagedStorage<HitBoxComponent> : std::true_type {};
+
+template<>
+struct UsePagedStorage<RenderableUnlit> : std::true_type {};
@@ -5,19 +5,49 @@
 class QueryBuilder {
 private:
     EntityStorage& storage;
-    ComponentBitMask bitMask;
+    QueryKey key;
+
+    template<typename T>
+    static constexpr size_t typeIndex() {
+        return static_cast<size_t>(ComponentToType<T>::index);
+    }
 
 public:
     QueryBuilder(EntityStorage& storage) : storage(storage) {}
 
     template<typename T>
     QueryBuilder& andHas() {
-        constexpr auto typeIndex = static_cast<size_t>(ComponentToType<T>::index);
-        bitMask.set(typeIndex, true);
+        key.all.set(typeIndex<T>(), true);
+        return *this;
+    }
+
+    template<typename T>
+    QueryBuilder& without() {
+        key.none.set(typeIndex<T>(), true);
+        return *this;
+    }
+
+    // Matches entities carrying at least one of the listed components.
+    template<typename... T>
+    QueryBuilder& anyOf() {
+        (key.any.set(typeIndex<T>(), true), ...);
+        return *this;
+    }
+
+    // Does not filter, the presence of T is reported per entity by
+    // getWithOptional().
+    template<typename T>
+    QueryBuilder& optional() {
+        key.optional.set(typeIndex<T>(), true);
         return *this;
     }
 
     const std::unordered_set<EntityID>& get() {
-        return storage.query(bitMask);
+        return storage.query(key).entities;
+    }
+
+    // Matches paired with the subset of optional<T>() components they have.
+    const std::unordered_map<EntityID, ComponentBitMask>& getWithOptional() {
+        return storage.query(key).optionalMasks;
     }
 };
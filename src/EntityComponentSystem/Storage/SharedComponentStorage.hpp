@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "ComponentStorage.hpp"
+
+// Backs Shared<T>: each distinct value is stored once and entities keep a
+// handle to it. Entities are also grouped by value, so systems can walk all
+// users of one value without filtering.
+template<typename T>
+class SharedComponentStorage : public IStorage {
+public:
+    struct Group {
+        T value;
+        std::unordered_set<EntityID> entities;
+    };
+
+private:
+    ComponentStorage<Shared<T>> handles;
+    std::vector<Group> groups;
+
+    void leaveGroup(EntityID id, EntityStorage& es) {
+        auto* shared = handles.getByIndex(es.getComponentIndex<Shared<T>>(id));
+        groups[shared->handle].entities.erase(id);
+    }
+
+public:
+    // Returns the handle of an equal value, storing it on first use. Values
+    // stay interned after their last entity is gone, the set is expected to
+    // be small (one per mesh/material combination).
+    std::uint32_t intern(const T& value) {
+        for (std::uint32_t handle = 0; handle < groups.size(); ++handle) {
+            if (groups[handle].value == value) return handle;
+        }
+        groups.push_back({value, {}});
+        return static_cast<std::uint32_t>(groups.size() - 1);
+    }
+
+    const T& value(std::uint32_t handle) const { return groups[handle].value; }
+    const std::vector<Group>& getGroups() const { return groups; }
+
+    size_t add(EntityID id, const Shared<T>& shared) {
+        groups[shared.handle].entities.insert(id);
+        return handles.add(id, shared);
+    }
+
+    // Points the entity at another value, moving it between the groups.
+    void set(EntityID id, const Shared<T>& shared, EntityStorage& es) {
+        auto* current = handles.getByIndex(es.getComponentIndex<Shared<T>>(id));
+        if (current->handle == shared.handle) return;
+        groups[current->handle].entities.erase(id);
+        groups[shared.handle].entities.insert(id);
+        *current = shared;
+    }
+
+    Shared<T>* getByIndex(size_t index) {
+        return handles.getByIndex(index);
+    }
+
+    void removeEntity(EntityID id, EntityStorage& es) override {
+        if (!es.hasComponent<Shared<T>>(id)) return;
+        leaveGroup(id, es);
+        handles.removeEntity(id, es);
+    }
+
+    void removeComponent(EntityID id, EntityStorage& es) override {
+        leaveGroup(id, es);
+        handles.removeComponent(id, es);
+    }
+
+    // Handle slots plus the interned values and their entity sets.
+    MemoryStats memoryStats() const override {
+        MemoryStats stats = handles.memoryStats();
+        stats.capacityBytes += groups.capacity() * sizeof(Group);
+        stats.liveBytes += groups.size() * sizeof(Group);
+        for (const auto& group : groups) {
+            const size_t setBytes = hashContainerBytes(group.entities);
+            stats.liveBytes += setBytes;
+            stats.capacityBytes += setBytes;
+        }
+        return stats;
+    }
+};
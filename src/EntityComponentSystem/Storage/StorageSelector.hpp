@@ -0,0 +1,21 @@
+#pragma once
+
+#include <type_traits>
+
+#include "ComponentStorage.hpp"
+#include "PagedComponentStorage.hpp"
+#include "SharedComponentStorage.hpp"
+
+// Maps a component type to the storage backend ECS::getStorage creates.
+template<typename T>
+struct StorageSelector {
+    using type = std::conditional_t<UsePagedStorage<T>::value, PagedComponentStorage<T>, ComponentStorage<T>>;
+};
+
+template<typename T>
+struct StorageSelector<Shared<T>> {
+    using type = SharedComponentStorage<T>;
+};
+
+template<typename T>
+using StorageFor = typename StorageSelector<T>::type;
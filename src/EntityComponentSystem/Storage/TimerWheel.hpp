@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "CommandBuffer.hpp"
+
+// Runs when its timer fires and records what should happen to the entity.
+using TimerAction = void (*)(CommandBuffer&, EntityID);
+
+struct TimerHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+// Hierarchical timing wheel counting simulation ticks. Level 0 has one
+// bucket per tick, every further level covers 64 buckets of the level below
+// and is cascaded down when the wheel reaches its next bucket. Scheduling and
+// cancelling are O(1), advance() only touches the buckets that come due.
+class TimerWheel {
+private:
+    static constexpr uint32_t LEVEL_BITS = 6;
+    static constexpr uint32_t BUCKETS = 1u << LEVEL_BITS;
+    static constexpr uint32_t LEVELS = 4;
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    struct Timer {
+        EntityID entity;
+        uint64_t due;
+        TimerAction action;
+        uint32_t prev;
+        uint32_t next;  // also links the free list
+        uint32_t bucket;
+        uint32_t generation = 0;
+    };
+
+    std::vector<Timer> timers;
+    std::array<uint32_t, LEVELS * BUCKETS> heads;
+    uint32_t firstFree = npos;
+    uint64_t now = 0;
+    size_t active = 0;
+
+    // Lowest level on which `due` still shares its bucket group with `now`.
+    uint32_t bucketFor(uint64_t due) const {
+        for (uint32_t level = 0; level < LEVELS; ++level) {
+            const uint32_t shift = LEVEL_BITS * (level + 1);
+            if ((due >> shift) == (now >> shift)) {
+                return level * BUCKETS + ((due >> (LEVEL_BITS * level)) & (BUCKETS - 1));
+            }
+        }
+        throw std::runtime_error("Timer delay exceeds the timing wheel range!");
+    }
+
+    void link(uint32_t index) {
+        auto& timer = timers[index];
+        timer.bucket = bucketFor(timer.due);
+        timer.prev = npos;
+        timer.next = heads[timer.bucket];
+        if (timer.next != npos) timers[timer.next].prev = index;
+        heads[timer.bucket] = index;
+    }
+
+    void unlink(uint32_t index) {
+        auto& timer = timers[index];
+        if (timer.prev != npos) {
+            timers[timer.prev].next = timer.next;
+        } else {
+            heads[timer.bucket] = timer.next;
+        }
+        if (timer.next != npos) timers[timer.next].prev = timer.prev;
+    }
+
+    void release(uint32_t index) {
+        auto& timer = timers[index];
+        ++timer.generation;
+        timer.action = nullptr;
+        timer.next = firstFree;
+        firstFree = index;
+        --active;
+    }
+
+    // Detaches a whole bucket and returns its first timer.
+    uint32_t take(uint32_t bucket) {
+        const uint32_t first = heads[bucket];
+        heads[bucket] = npos;
+        return first;
+    }
+
+public:
+    TimerWheel() { heads.fill(npos); }
+
+    // Fires `action` for `entity` `delay` ticks from now, at least one.
+    TimerHandle schedule(EntityID entity, uint64_t delay, TimerAction action) {
+        uint32_t index = firstFree;
+        if (index == npos) {
+            index = static_cast<uint32_t>(timers.size());
+            timers.push_back({});
+        } else {
+            firstFree = timers[index].next;
+        }
+        auto& timer = timers[index];
+        timer.entity = entity;
+        timer.due = now + (delay == 0 ? 1 : delay);
+        timer.action = action;
+        link(index);
+        ++active;
+        return {index, timer.generation};
+    }
+
+    // Returns false when the timer already fired or was cancelled.
+    bool cancel(TimerHandle handle) {
+        if (handle.index >= timers.size()) return false;
+        auto& timer = timers[handle.index];
+        if (timer.generation != handle.generation || timer.action == nullptr) return false;
+        unlink(handle.index);
+        release(handle.index);
+        return true;
+    }
+
+    // Moves to the next tick and records the actions of every timer due on it.
+    void advance(CommandBuffer& commands) {
+        ++now;
+        for (uint32_t level = LEVELS - 1; level > 0; --level) {
+            const uint32_t shift = LEVEL_BITS * level;
+            if ((now & ((uint64_t{1} << shift) - 1)) != 0) continue;
+            uint32_t index = take(level * BUCKETS + ((now >> shift) & (BUCKETS - 1)));
+            while (index != npos) {
+                const uint32_t next = timers[index].next;
+                link(index);
+                index = next;
+            }
+        }
+
+        uint32_t index = take(now & (BUCKETS - 1));
+        while (index != npos) {
+            const uint32_t next = timers[index].next;
+            timers[index].action(commands, timers[index].entity);
+            release(index);
+            index = next;
+        }
+    }
+
+    uint64_t currentTick() const { return now; }
+    size_t size() const { return active; }
+};
@@ -1,49 +1,181 @@
 #pragma once
 #include "../ECS.hpp"
-#include "QuadTree.hpp"
+#include "../Resources/BroadphaseStats.hpp"
+#include "CollisionProxies.hpp"
+#include "LooseQuadTree.hpp"
+#include "NarrowphaseBatch.hpp"
+#include "SimLodSystem.hpp"
+#include "UniformGrid.hpp"
 
 inline bool collide(const float& aX, const float& aY, const float& aR,
                     const float& bX, const float& bY, const float& bR) {
     return (bX - aX) * (bX - aX) + (bY - aY) * (bY - aY) < (aR + bR) * (aR + bR);
 }
 
-constexpr float repulsive_force = 3.f;
+// Entities that look for their own overlaps this tick. Idle LOD tiers and
+// sleeping bodies are only found by others.
+inline bool collisionSource(ECS& ecs, EntityID entity, const float& deltaTime) {
+    float step;
+    return simLodDue(ecs, entity, deltaTime, step) &&
+           !ecs.entityStorage.hasComponent<SleepingComponent>(entity);
+}
+
+// Adds `entity` to the proxies with its collision layer. Entities with
+// continuous collision sweep their motion of this tick.
+inline void addCollisionProxy(ECS& ecs, CollisionProxies& proxies, EntityID entity,
+                              const PositionComponent& pos, float r, bool source) {
+    const auto* layer = ecs.getComponent<CollisionLayerComponent>(entity);
+    const CollisionLayer collisionLayer = layer != nullptr ? layer->layer : CollisionLayer::Default;
+    if (ecs.entityStorage.hasComponent<ContinuousCollisionComponent>(entity)) {
+        if (const auto* previous = ecs.getComponent<PreviousPositionComponent>(entity)) {
+            proxies.addSwept(entity, previous->x, previous->y, pos.x, pos.y, r, source, collisionLayer);
+            return;
+        }
+    }
+    proxies.add(entity, pos.x, pos.y, r, source, collisionLayer);
+}
+
+// Earliest fraction of the tick at which circle a, moving by (adx, ady) from
+// (ax, ay), touches circle b moving by (bdx, bdy) from (bx, by). Solves
+// |p + t v| = ar + br for the relative start offset p and motion v.
+inline bool sweptCircles(float ax, float ay, float adx, float ady, float ar,
+                         float bx, float by, float bdx, float bdy, float br, float& t) {
+    const float px = bx - ax;
+    const float py = by - ay;
+    const float vx = bdx - adx;
+    const float vy = bdy - ady;
+    const float reach = ar + br;
+    const float c = px * px + py * py - reach * reach;
+    if (c < 0.0f) {
+        t = 0.0f;
+        return true;
+    }
+    const float a = vx * vx + vy * vy;
+    const float b = px * vx + py * vy;
+    if (a == 0.0f || b >= 0.0f) return false;  // not approaching
+    const float discriminant = b * b - a * c;
+    if (discriminant < 0.0f) return false;
+    t = (-b - std::sqrt(discriminant)) / a;
+    return t <= 1.0f;
+}
+
+// Contact of two proxies of which at least one is swept. The normal is taken
+// at the time of impact, the depth is the overlap left at the end of the tick.
+inline bool sweptContact(const CollisionProxies& proxies, size_t i, size_t j, float& nx, float& ny, float& depth) {
+    auto body = [&](size_t k, float& sx, float& sy, float& r) {
+        const float length = std::sqrt(proxies.dx[k] * proxies.dx[k] + proxies.dy[k] * proxies.dy[k]);
+        sx = proxies.x[k] - 0.5f * proxies.dx[k];
+        sy = proxies.y[k] - 0.5f * proxies.dy[k];
+        r = proxies.r[k] - 0.5f * length;
+    };
+    float ax, ay, ar, bx, by, br;
+    body(i, ax, ay, ar);
+    body(j, bx, by, br);
+
+    float t;
+    if (!sweptCircles(ax, ay, proxies.dx[i], proxies.dy[i], ar, bx, by, proxies.dx[j], proxies.dy[j], br, t)) {
+        return false;
+    }
+    nx = (bx + t * proxies.dx[j]) - (ax + t * proxies.dx[i]);
+    ny = (by + t * proxies.dy[j]) - (ay + t * proxies.dy[i]);
+    float dist = std::sqrt(nx * nx + ny * ny);
+    if (dist == 0.f) { nx = 1.f; ny = 0.f; dist = 1.f; }
+    nx /= dist;
+    ny /= dist;
 
-inline void collidingSystem(ECS& ecs, const float& deltaTime, RenderingQueues& renderingQueues) {
-    auto entities = ecs.getEntitiesWithComponent<HitBoxComponent>().andHas<PositionComponent>().get();
+    const float ex = (bx + proxies.dx[j]) - (ax + proxies.dx[i]);
+    const float ey = (by + proxies.dy[j]) - (ay + proxies.dy[i]);
+    depth = std::max(ar + br - std::sqrt(ex * ex + ey * ey), 0.0f);
+    return true;
+}
+
+// Calls `emit(j, nx, ny, depth)` for every overlap of proxy `i` that `i` is
+// responsible for. Each overlap is emitted once, from its lower source id. A
+// source also takes the pairs its idle or sleeping neighbours skip. The
+// broadphase candidates left after the id and layer checks are tested in one
+// batch, and only the overlaps reach the contact math.
+template<typename Broadphase, typename Emit>
+void collideProxy(const CollisionProxies& proxies, const Broadphase& broadphase, size_t i,
+                  NarrowphaseBatch& batch, Emit&& emit) {
+    const EntityID entity = proxies.ids[i];
+    const float x = proxies.x[i];
+    const float y = proxies.y[i];
+    const float r = proxies.r[i];
 
-    AABB worldBounds{0.f, 0.f, 500.f, 500.f};
-    QuadTree quadTree(worldBounds);
+    batch.clear();
+    broadphase.query(proxies, i, [&](uint32_t j) {
+        const EntityID other = proxies.ids[j];
+        if (other == entity || (other < entity && proxies.source[j])) return;
+        if (!proxies.interacts(i, j)) return;
+        batch.add(proxies, j);
+    });
 
-    for (auto entity : entities) {
-        auto pos = ecs.getComponent<PositionComponent>(entity);
-#ifndef NDEBUG
-        if (!quadTree.insert(entity, pos->x, pos->y)) {
-            std::cout << "Entity " << entity << " out of world bounds" << std::endl;
+    for (const uint32_t k : batch.overlapping(x, y, r)) {
+        const uint32_t j = batch.candidates[k];
+        if (proxies.swept(i) || proxies.swept(j)) {
+            float nx, ny, depth;
+            if (sweptContact(proxies, i, j, nx, ny, depth)) emit(j, nx, ny, depth);
+            continue;
         }
-#else
-        quadTree.insert(entity, pos->x, pos->y);
-#endif
+
+        float dx = proxies.x[j] - x;
+        float dy = proxies.y[j] - y;
+        float dist = std::sqrt(dx*dx + dy*dy);
+
+        if (dist == 0.f) { dx = 1.f; dy = 0.f; dist = 1.f; }
+
+        emit(j, dx / dist, dy / dist, r + proxies.r[j] - dist);
     }
+}
 
-    for (auto entity : entities) {
-        auto pos = ecs.getComponent<PositionComponent>(entity);
-        auto col = ecs.getComponent<HitBoxComponent>(entity);
+// Brings ecs.contactPairs up to date with this tick's contacts. A pair that
+// was not found is kept while neither body looked for overlaps this tick.
+inline void updateContactPairs(ECS& ecs, const float& deltaTime) {
+    auto skipped = [&](EntityID entity) {
+        return ecs.entityStorage.isActive(entity) && ecs.entityStorage.hasComponent<HitBoxComponent>(entity) &&
+               !collisionSource(ecs, entity, deltaTime);
+    };
+    ecs.contactPairs.update(ecs.contacts, [&](EntityID a, EntityID b) { return skipped(a) && skipped(b); });
+}
 
-        AABB range{pos->x, pos->y, col->r, col->r};
-        std::vector<EntityID> candidates;
-        quadTree.query(range, candidates);
+// Fills ecs.contacts with this tick's overlaps and carries them into
+// ecs.contactPairs. The broadphase is brought up
+// to date from a flat proxy copy every pass and keeps its state between
+// passes; it needs build(proxies) and query(proxies, index, visit), where
+// query visits at least every proxy overlapping `index` and j is visited for
+// i whenever i is visited for j.
+template<typename Broadphase>
+class CollidingSystem {
+private:
+    CollisionProxies proxies;
+    Broadphase broadphase;
+    NarrowphaseBatch batch;
 
-        for (auto other : candidates) {
-            if (other == entity) continue;
+public:
+    void operator()(ECS& ecs, const float& deltaTime, RenderingQueues&) {
+        const auto& entities = ecs.getEntitiesWithComponent<HitBoxComponent>().andHas<PositionComponent>().get();
 
-            auto posB = ecs.getComponent<PositionComponent>(other);
-            auto colB = ecs.getComponent<HitBoxComponent>(other);
+        proxies.clear();
+        for (auto entity : entities) {
+            const auto& pos = *ecs.getComponent<PositionComponent>(entity);
+            const auto& col = *ecs.getComponent<HitBoxComponent>(entity);
+            addCollisionProxy(ecs, proxies, entity, pos, col.r, collisionSource(ecs, entity, deltaTime));
+        }
+        broadphase.build(proxies);
+        if constexpr (requires { broadphase.stats(); }) {
+            ecs.resource<BroadphaseStats>() = broadphase.stats();
+        }
 
-            if (collide(pos->x, pos->y, col->r, posB->x, posB->y, colB->r)) {
-                col->collidedWith.insert(other);
-                colB->collidedWith.insert(entity);
-            }
+        // Idle and sleeping bodies stay in the broadphase for the sources to
+        // find, but are not walked themselves.
+        ecs.contacts.clear();
+        for (const uint32_t i : proxies.sources) {
+            collideProxy(proxies, broadphase, i, batch, [&](uint32_t j, float nx, float ny, float depth) {
+                ecs.contacts.emit(proxies.ids[i], proxies.ids[j], nx, ny, depth);
+            });
         }
+
+        ecs.contacts.sortByEntity();
+        updateContactPairs(ecs, deltaTime);
     }
-}
+};
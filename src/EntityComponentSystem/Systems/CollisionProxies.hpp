@@ -0,0 +1,72 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../Components/CollisionLayerComponent.hpp"
+#include "../Storage/EntityStorage.hpp"
+
+// Flat copy of everything the broadphase and narrowphase read, gathered once
+// per collision pass so neither touches component storage per candidate.
+// The broadphase only sees the circle (x, y, r). A swept proxy's circle
+// bounds its whole motion (dx, dy): the body starts at (x, y) - (dx, dy) / 2,
+// ends at (x, y) + (dx, dy) / 2 and has radius r - |(dx, dy)| / 2.
+struct CollisionProxies {
+    std::vector<EntityID> ids;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> r;
+    std::vector<float> dx;  // motion this tick, zero unless swept
+    std::vector<float> dy;
+    std::vector<uint8_t> source;  // looks for its own overlaps this tick
+    std::vector<uint32_t> layer;  // collisionLayerBit() of the proxy's layer
+    std::vector<uint32_t> mask;   // layers it can touch
+    std::vector<uint32_t> sources;  // indices of the proxies with `source` set, ascending
+    float maxRadius = 0.0f;
+
+    void clear() {
+        ids.clear();
+        x.clear();
+        y.clear();
+        r.clear();
+        dx.clear();
+        dy.clear();
+        source.clear();
+        layer.clear();
+        mask.clear();
+        sources.clear();
+        maxRadius = 0.0f;
+    }
+
+    void add(EntityID id, float px, float py, float radius, bool isSource,
+             CollisionLayer collisionLayer = CollisionLayer::Default) {
+        if (isSource) sources.push_back(static_cast<uint32_t>(ids.size()));
+        ids.push_back(id);
+        x.push_back(px);
+        y.push_back(py);
+        r.push_back(radius);
+        dx.push_back(0.0f);
+        dy.push_back(0.0f);
+        source.push_back(isSource);
+        layer.push_back(collisionLayerBit(collisionLayer));
+        mask.push_back(collisionMaskOf(collisionLayer));
+        if (radius > maxRadius) maxRadius = radius;
+    }
+
+    // Body of `radius` moving from (fromX, fromY) to (toX, toY) this tick.
+    void addSwept(EntityID id, float fromX, float fromY, float toX, float toY, float radius, bool isSource,
+                  CollisionLayer collisionLayer = CollisionLayer::Default) {
+        const float mx = toX - fromX;
+        const float my = toY - fromY;
+        add(id, 0.5f * (fromX + toX), 0.5f * (fromY + toY), radius + 0.5f * std::sqrt(mx * mx + my * my), isSource,
+            collisionLayer);
+        dx.back() = mx;
+        dy.back() = my;
+    }
+
+    bool swept(size_t i) const { return dx[i] != 0.0f || dy[i] != 0.0f; }
+
+    bool interacts(size_t i, size_t j) const { return (layer[i] & mask[j]) != 0 && (layer[j] & mask[i]) != 0; }
+
+    size_t size() const { return ids.size(); }
+};
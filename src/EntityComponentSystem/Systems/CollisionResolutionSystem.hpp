@@ -1,60 +1,104 @@
 #pragma once
+#include <algorithm>
+#include <iostream>
+
 #include "../ECS.hpp"
 
-inline void collisionResolutionSystem(ECS& ecs, const float& deltaTime, RenderingQueues& renderingQueues) {
-    auto entities = ecs.getEntitiesWithComponent<HitBoxComponent>().andHas<PositionComponent>().get();
-
-    for (auto entity : entities) {
-        auto pos = ecs.getComponent<PositionComponent>(entity);
-        auto col = ecs.getComponent<HitBoxComponent>(entity);
-
-        for (auto other : col->collidedWith) {
-
-            if (ecs.entityStorage.hasComponent<PlayerMovementComponent>(entity) && ecs.entityStorage.hasComponent<CoinComponent>(other)) {
-                const auto& value = ecs.getComponent<CoinComponent>(other)->value;
-                std::cout << "Picked up: " << value << "\n";
-                gMusicManager.play(SoundID::Coin);
-                ecs.addComponent(other, RemoveComponent{});
-            }
-
-            if (ecs.entityStorage.hasComponent<BulletComponent>(other)) {
-                if (ecs.entityStorage.hasComponent<BulletComponent>(entity)) continue;
-                if (ecs.entityStorage.hasComponent<PlayerMovementComponent>(entity)) continue;
-                if (ecs.entityStorage.hasComponent<FollowPlayerComponent>(entity)) ecs.addComponent(entity, RemoveComponent{});;
-                ecs.addComponent(other, RemoveComponent{});
-            }
-
-            if (entity < other) {
-                auto posB = ecs.getComponent<PositionComponent>(other);
-                auto colB = ecs.getComponent<HitBoxComponent>(other);
-
-                float dx = posB->x - pos->x;
-                float dy = posB->y - pos->y;
-                float distSq = dx*dx + dy*dy;
-                float dist = std::sqrt(distSq);
-
-                if (dist == 0.f) { dx = 1.f; dy = 0.f; dist = 1.f; }
-
-                float overlap = (col->r + colB->r - dist);
-                float nx = dx / dist;
-                float ny = dy / dist;
-
-                float pushA = 0.5f * overlap;
-                float pushB = 0.5f * overlap;
-
-                if (ecs.entityStorage.hasComponent<CollidingComponent>(entity) && ecs.entityStorage.hasComponent<CollidingComponent>(other)) {
-                    if (ecs.entityStorage.hasComponent<MovableComponent>(entity)) {
-                        pos->x -= nx * pushA;
-                        pos->y -= ny * pushA;
-                    }
-
-                    if (ecs.entityStorage.hasComponent<MovableComponent>(other)) {
-                        posB->x += nx * pushB;
-                        posB->y += ny * pushB;
-                    }
-                }
-            }
+// Whether a touching pair is pushed apart. Bullets pass through each other
+// and the player.
+inline bool pushesApart(const ComponentBitMask& maskA, const ComponentBitMask& maskB) {
+    if (!maskHas<CollidingComponent>(maskA) || !maskHas<CollidingComponent>(maskB)) return false;
+    if (maskHas<BulletComponent>(maskA)) {
+        return !maskHas<BulletComponent>(maskB) && !maskHas<PlayerMovementComponent>(maskB);
+    }
+    if (maskHas<BulletComponent>(maskB)) return !maskHas<PlayerMovementComponent>(maskA);
+    return true;
+}
+
+// Gameplay side of `entity` touching `other`.
+inline void applyContactRules(ECS& ecs, EntityID entity, const ComponentBitMask& entityMask,
+                              EntityID other, const ComponentBitMask& otherMask) {
+    if (maskHas<PlayerMovementComponent>(entityMask) && maskHas<CoinComponent>(otherMask)) {
+        const auto& value = ecs.getComponent<CoinComponent>(other)->value;
+        std::cout << "Picked up: " << value << "\n";
+        gMusicManager.play(SoundID::Coin);
+        ecs.addComponent(other, RemoveComponent{});
+    }
+
+    if (maskHas<BulletComponent>(otherMask) && !maskHas<BulletComponent>(entityMask) &&
+        !maskHas<PlayerMovementComponent>(entityMask)) {
+        if (maskHas<FollowPlayerComponent>(entityMask)) ecs.addComponent(entity, RemoveComponent{});
+        ecs.addComponent(other, RemoveComponent{});
+    }
+}
+
+// Runs the gameplay rules of the contacts that began in the last collision
+// pass. Persisting contacts trigger nothing.
+inline void applyBeganContactRules(ECS& ecs) {
+    for (const auto& [a, b] : ecs.contactPairs.began()) {
+        const auto maskA = ecs.entityStorage.getComponentMask(a);
+        const auto maskB = ecs.entityStorage.getComponentMask(b);
+        applyContactRules(ecs, a, maskA, b, maskB);
+        applyContactRules(ecs, b, maskB, a, maskA);
+    }
+}
+
+// Share of the correction a new contact applies in one tick, so stacked
+// contacts settle instead of fighting.
+constexpr float contact_relaxation = 0.5f;
+
+// Share of last tick's push a persisting contact starts from, which takes it
+// to the full correction in fewer ticks.
+constexpr float contact_warm_start = 0.5f;
+
+// Overlap left in place, so resting bodies keep touching and their contact
+// stays instead of ending and beginning again every other tick.
+constexpr float contact_slop = 0.01f;
+
+// Push applied to each side of a contact, warm started from its cached pair
+// and recorded there for the next tick. A side's share of the correction is
+// all of it against a static body and half when both sides move; the warm
+// start is added before capping at that share, so the pair never overshoots.
+inline float contactPush(ContactPair* pair, float depth, bool bothMovable) {
+    const float share = (bothMovable ? 0.5f : 1.0f) * std::max(depth - contact_slop, 0.0f);
+    float push = contact_relaxation * share;
+    if (pair == nullptr) return push;
+    if (pair->age > 0) {
+        push = std::min(push + contact_warm_start * pair->push, share);
+    }
+    pair->push = push;
+    pair->accumulatedPush += push;
+    return push;
+}
+
+// Runs the gameplay rules of this tick's contacts without moving anything,
+// for collision paths that separate bodies themselves.
+inline void contactRulesSystem(ECS& ecs, const float&, RenderingQueues&) {
+    applyBeganContactRules(ecs);
+}
+
+inline void collisionResolutionSystem(ECS& ecs, const float&, RenderingQueues&) {
+    applyBeganContactRules(ecs);
+    for (const auto& [a, b, nx, ny, depth] : ecs.contacts.getAll()) {
+        // One lookup per side, every rule below is a bit test.
+        const auto maskA = ecs.entityStorage.getComponentMask(a);
+        const auto maskB = ecs.entityStorage.getComponentMask(b);
+        if (!pushesApart(maskA, maskB)) continue;
+
+        const bool movableA = maskHas<MovableComponent>(maskA);
+        const bool movableB = maskHas<MovableComponent>(maskB);
+        const float push = contactPush(ecs.contactPairs.find(a, b), depth, movableA && movableB);
+
+        if (movableA) {
+            auto pos = ecs.getComponent<PositionComponent>(a);
+            pos->x -= nx * push;
+            pos->y -= ny * push;
+        }
+
+        if (movableB) {
+            auto posB = ecs.getComponent<PositionComponent>(b);
+            posB->x += nx * push;
+            posB->y += ny * push;
         }
-        col->collidedWith.clear();
     }
 }
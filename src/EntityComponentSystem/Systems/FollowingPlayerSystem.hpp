@@ -1,26 +1,33 @@
 #pragma once
 #include "../ECS.hpp"
+#include "../Resources/PlayerState.hpp"
+#include "SimLodSystem.hpp"
 
-inline void followingPlayerSystem(ECS& ecs, const float& deltaTime, RenderingQueues& renderingQueues) {
-    auto entities = ecs.getEntitiesWithComponent<FollowPlayerComponent>()
+inline void followingPlayerSystem(ECS& ecs, const float& deltaTime, RenderingQueues&) {
+    const auto& entities = ecs.getEntitiesWithComponent<FollowPlayerComponent>()
                                                .andHas<PositionComponent>()
                                                .andHas<MovableComponent>()
                                                .get();
-    auto player = ecs.getEntitiesWithComponent<PlayerMovementComponent>().get();
-    PositionComponent* playerPos = nullptr;
-    if (player.size() == 1) {
-        playerPos = ecs.getComponent<PositionComponent>(*player.begin());
-    }
-    if (playerPos == nullptr) {
+    const auto& player = ecs.resource<PlayerState>();
+    if (!player.alive) {
         return;
     }
-    for (auto entity : entities) {
-        auto& [playerX, playerY, playerZ] = *playerPos;
-        auto& [entityX, entityY, entityZ] = *ecs.getComponent<PositionComponent>(entity);
-        auto& [entityDx, entityDy, entitySpeed, entityAcc] = *ecs.getComponent<MovableComponent>(entity);
+    // Steering is latency tolerant, each run only turns the followers that
+    // fit its budget. Followers whose LOD tier is not due stay in the walk
+    // until it is, whatever the phase of the slice.
+    auto ready = [&](EntityID entity) {
+        float step;
+        return !ecs.entityStorage.isActive(entity) || simLodDue(ecs, entity, deltaTime, step);
+    };
+    for (auto entity : ecs.budgetedSlice(entities, ready)) {
+        auto* position = ecs.getComponent<PositionComponent>(entity);
+        auto* movable = ecs.getComponent<MovableComponent>(entity);
+        if (position == nullptr || movable == nullptr) continue;
+        auto& [entityX, entityY, entityZ] = *position;
+        auto& [entityDx, entityDy, entitySpeed, entityAcc] = *movable;
 
-        float dirX = playerX - entityX;
-        float dirY = playerY - entityY;
+        float dirX = player.x - entityX;
+        float dirY = player.y - entityY;
 
         float length = std::sqrt(dirX * dirX + dirY * dirY);
         if (length > 0.0f) {
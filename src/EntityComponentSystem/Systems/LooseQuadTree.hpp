@@ -0,0 +1,322 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "../Resources/BroadphaseStats.hpp"
+#include "../Storage/EntityStorage.hpp"
+#include "CollisionProxies.hpp"
+#include "QuadTree.hpp"
+
+// Quadtree kept between passes. Every node's loose bounds are its cell grown
+// to twice the size, an entity lives in the deepest node whose loose bounds
+// hold its whole circle and stays there until it leaves them, so a pass only
+// relocates entities that moved noticeably. Entities store their position and
+// radius in the tree and queries test them against the range exactly. The
+// world is unbounded: an entity leaving the root grows a new root around it.
+class LooseQuadTree {
+private:
+    static constexpr uint32_t LEAF_CAPACITY = 8;
+    static constexpr uint8_t MAX_DEPTH = 12;
+    static constexpr uint32_t npos = UINT32_MAX;
+    // Traversal stacks hold three nodes per level plus four; growing the
+    // root deepens the tree, but a float cell cannot double past 128 times.
+    static constexpr size_t STACK_SIZE = 4 * 256;
+
+    struct Node {
+        float cx, cy, half;   // cell, the loose bounds are cx +- 2 * half
+        uint32_t parent;
+        uint32_t firstChild;  // four consecutive nodes, npos for leaves
+        uint32_t head;        // first item stored here
+        uint32_t count;       // items stored here
+        uint32_t total;       // items in the subtree
+        uint8_t depth;
+    };
+
+    struct Item {
+        EntityID id;
+        float x, y, r;
+        uint32_t proxy;     // index into the proxies of the current pass
+        uint32_t node;      // npos while the item is free
+        uint32_t prev, next;  // next also links the free list
+        uint32_t seen;      // pass the entity was last gathered in
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeBlocks;  // first nodes of released child blocks
+    std::vector<Item> items;
+    uint32_t firstFreeItem = npos;
+    std::unordered_map<EntityID, uint32_t> itemOf;
+    uint32_t pass = 0;
+    BroadphaseStats statistics;
+
+    static bool fits(const Node& node, const Item& item) {
+        const float loose = 2.0f * node.half;
+        return item.r <= node.half &&
+               std::abs(item.x - node.cx) + item.r <= loose &&
+               std::abs(item.y - node.cy) + item.r <= loose;
+    }
+
+    static bool overlaps(const Node& node, const AABB& range) {
+        const float loose = 2.0f * node.half;
+        return std::abs(node.cx - range.x) <= loose + range.halfW &&
+               std::abs(node.cy - range.y) <= loose + range.halfH;
+    }
+
+    static bool overlaps(const Item& item, const AABB& range) {
+        return std::abs(item.x - range.x) <= item.r + range.halfW &&
+               std::abs(item.y - range.y) <= item.r + range.halfH;
+    }
+
+
+    void attach(uint32_t nodeIndex, uint32_t itemIndex) {
+        auto& item = items[itemIndex];
+        auto& node = nodes[nodeIndex];
+        item.node = nodeIndex;
+        item.prev = npos;
+        item.next = node.head;
+        if (node.head != npos) items[node.head].prev = itemIndex;
+        node.head = itemIndex;
+        ++node.count;
+    }
+
+    void detach(uint32_t itemIndex) {
+        auto& item = items[itemIndex];
+        auto& node = nodes[item.node];
+        if (item.prev != npos) {
+            items[item.prev].next = item.next;
+        } else {
+            node.head = item.next;
+        }
+        if (item.next != npos) items[item.next].prev = item.prev;
+        --node.count;
+    }
+
+    uint32_t allocateBlock() {
+        if (!freeBlocks.empty()) {
+            const uint32_t first = freeBlocks.back();
+            freeBlocks.pop_back();
+            return first;
+        }
+        nodes.resize(nodes.size() + 4);
+        return static_cast<uint32_t>(nodes.size() - 4);
+    }
+
+    void split(uint32_t nodeIndex) {
+        const uint32_t first = allocateBlock();
+        const Node parent = nodes[nodeIndex];
+        const float half = parent.half * 0.5f;
+        for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+            nodes[first + quadrant] = {parent.cx + ((quadrant & 1) ? half : -half),
+                                       parent.cy + ((quadrant & 2) ? half : -half),
+                                       half, nodeIndex, npos, npos, 0, 0,
+                                       static_cast<uint8_t>(parent.depth + 1)};
+        }
+        nodes[nodeIndex].firstChild = first;
+
+        // Push down whatever fits a child, the rest stays.
+        uint32_t itemIndex = nodes[nodeIndex].head;
+        while (itemIndex != npos) {
+            const uint32_t next = items[itemIndex].next;
+            const uint32_t child = childFor(nodeIndex, items[itemIndex]);
+            if (child != npos) {
+                detach(itemIndex);
+                attach(child, itemIndex);
+                ++nodes[child].total;
+            }
+            itemIndex = next;
+        }
+    }
+
+    uint32_t childFor(uint32_t nodeIndex, const Item& item) const {
+        const Node& node = nodes[nodeIndex];
+        if (node.firstChild == npos) return npos;
+        const uint32_t child = node.firstChild + (item.x >= node.cx ? 1 : 0) + (item.y >= node.cy ? 2 : 0);
+        return fits(nodes[child], item) ? child : npos;
+    }
+
+    // Descends from the root, which must hold the item.
+    void insert(uint32_t itemIndex) {
+        uint32_t nodeIndex = 0;
+        while (true) {
+            ++nodes[nodeIndex].total;
+            const uint32_t child = childFor(nodeIndex, items[itemIndex]);
+            if (child == npos) break;
+            nodeIndex = child;
+        }
+        attach(nodeIndex, itemIndex);
+        const Node& node = nodes[nodeIndex];
+        if (node.firstChild == npos && node.count > LEAF_CAPACITY && node.depth < MAX_DEPTH) {
+            split(nodeIndex);
+        }
+    }
+
+    // Detaches the item and releases the children of the highest ancestor
+    // that became empty.
+    void remove(uint32_t itemIndex) {
+        uint32_t nodeIndex = items[itemIndex].node;
+        detach(itemIndex);
+        uint32_t emptied = npos;
+        while (nodeIndex != npos) {
+            if (--nodes[nodeIndex].total == 0) emptied = nodeIndex;
+            nodeIndex = nodes[nodeIndex].parent;
+        }
+        if (emptied != npos) release(emptied);
+        items[itemIndex].node = npos;
+    }
+
+    void release(uint32_t nodeIndex) {
+        std::array<uint32_t, STACK_SIZE> stack;
+        size_t top = 0;
+        stack[top++] = nodeIndex;
+        while (top > 0) {
+            Node& node = nodes[stack[--top]];
+            if (node.firstChild == npos) continue;
+            freeBlocks.push_back(node.firstChild);
+            for (uint32_t child = 0; child < 4; ++child) stack[top++] = node.firstChild + child;
+            node.firstChild = npos;
+        }
+    }
+
+    uint32_t allocateItem() {
+        if (firstFreeItem == npos) {
+            items.push_back({});
+            return static_cast<uint32_t>(items.size() - 1);
+        }
+        const uint32_t index = firstFreeItem;
+        firstFreeItem = items[index].next;
+        return index;
+    }
+
+    void freeItem(uint32_t itemIndex) {
+        itemOf.erase(items[itemIndex].id);
+        items[itemIndex].next = firstFreeItem;
+        firstFreeItem = itemIndex;
+    }
+
+    // Doubles the root toward `item` until its loose bounds hold it. The old
+    // root becomes one quadrant of the new one and keeps its subtree.
+    void growRoot(const Item& item) {
+        while (!fits(nodes[0], item)) {
+            const Node old = nodes[0];
+            const float sx = item.x >= old.cx ? 1.0f : -1.0f;
+            const float sy = item.y >= old.cy ? 1.0f : -1.0f;
+            const float cx = old.cx + sx * old.half;
+            const float cy = old.cy + sy * old.half;
+
+            // Depth only limits splitting, the whole tree moves one level down.
+            for (auto& node : nodes) node.depth = static_cast<uint8_t>(std::min(node.depth + 1, 255));
+
+            const uint32_t first = allocateBlock();
+            for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+                nodes[first + quadrant] = {cx + ((quadrant & 1) ? old.half : -old.half),
+                                           cy + ((quadrant & 2) ? old.half : -old.half),
+                                           old.half, 0, npos, npos, 0, 0, 1};
+            }
+            // The old root is the quadrant facing away from the item.
+            const uint32_t moved = first + (sx < 0.0f ? 1 : 0) + (sy < 0.0f ? 2 : 0);
+            nodes[moved] = nodes[0];
+            nodes[moved].parent = 0;
+            for (uint32_t i = old.head; i != npos; i = items[i].next) items[i].node = moved;
+            if (old.firstChild != npos) {
+                for (uint32_t child = 0; child < 4; ++child) nodes[old.firstChild + child].parent = moved;
+            }
+            nodes[0] = {cx, cy, 2.0f * old.half, npos, first, npos, 0, old.total, 0};
+            ++statistics.rootGrowths;
+        }
+        statistics.rootHalfSize = nodes[0].half;
+    }
+
+    template<typename Visit>
+    void visitRange(const AABB& range, Visit&& visit) const {
+        if (nodes.empty() || nodes[0].total == 0) return;
+        std::array<uint32_t, STACK_SIZE> stack;
+        size_t top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (node.total == 0 || !overlaps(node, range)) continue;
+            for (uint32_t itemIndex = node.head; itemIndex != npos; itemIndex = items[itemIndex].next) {
+                if (overlaps(items[itemIndex], range)) visit(items[itemIndex]);
+            }
+            if (node.firstChild == npos) continue;
+            for (uint32_t child = 0; child < 4; ++child) stack[top++] = node.firstChild + child;
+        }
+    }
+
+public:
+    // Brings the tree up to date with this pass's proxies. Entities that
+    // were not gathered are removed, ones at a non-finite position are left out.
+    void build(const CollisionProxies& proxies) {
+        ++pass;
+        statistics.proxies = proxies.size();
+        statistics.relocated = 0;
+        statistics.nonFinite = 0;
+        statistics.minX = statistics.minY = std::numeric_limits<float>::max();
+        statistics.maxX = statistics.maxY = std::numeric_limits<float>::lowest();
+
+        for (size_t i = 0; i < proxies.size(); ++i) {
+            const float x = proxies.x[i];
+            const float y = proxies.y[i];
+            const float r = proxies.r[i];
+            if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(r)) {
+                ++statistics.nonFinite;
+                continue;
+            }
+            statistics.minX = std::min(statistics.minX, x);
+            statistics.minY = std::min(statistics.minY, y);
+            statistics.maxX = std::max(statistics.maxX, x);
+            statistics.maxY = std::max(statistics.maxY, y);
+
+            if (nodes.empty()) {
+                // The first entity ever seen places the root, which grows from there.
+                nodes.push_back({x, y, std::max(r, 1.0f), npos, npos, npos, 0, 0, 0});
+            }
+
+            auto [it, inserted] = itemOf.try_emplace(proxies.ids[i], npos);
+            if (inserted) it->second = allocateItem();
+            const uint32_t index = it->second;
+            auto& item = items[index];
+            item = {proxies.ids[i], x, y, r, static_cast<uint32_t>(i),
+                    inserted ? npos : item.node, item.prev, item.next, pass};
+
+            if (!inserted && fits(nodes[item.node], item)) continue;
+            if (!inserted) remove(index);
+            growRoot(item);
+            insert(index);
+            ++statistics.relocated;
+        }
+        if (statistics.proxies == statistics.nonFinite) {
+            statistics.minX = statistics.minY = statistics.maxX = statistics.maxY = 0.0f;
+        }
+
+        for (uint32_t i = 0; i < items.size(); ++i) {
+            if (items[i].node != npos && items[i].seen != pass) {
+                remove(i);
+                freeItem(i);
+            }
+        }
+    }
+
+    // Calls `visit` with every proxy whose bounding box overlaps the one of
+    // `index`, including `index` itself.
+    template<typename Visit>
+    void query(const CollisionProxies& proxies, size_t index, Visit&& visit) const {
+        const float r = proxies.r[index];
+        visitRange(AABB{proxies.x[index], proxies.y[index], r, r},
+                   [&](const Item& item) { visit(item.proxy); });
+    }
+
+    void query(const AABB& range, std::vector<EntityID>& found) const {
+        visitRange(range, [&](const Item& item) { found.push_back(item.id); });
+    }
+
+    // Entities inserted or moved to another node by the last build.
+    size_t relocated() const { return statistics.relocated; }
+
+    const BroadphaseStats& stats() const { return statistics; }
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "../ECS.hpp"
+
+// Spreads the low 16 bits of `v` over the even bits of the result.
+inline uint32_t spreadBits(uint32_t v) {
+    v &= 0x0000ffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+inline uint32_t mortonCode(uint32_t x, uint32_t y) {
+    return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+// Maintenance pass that reorders the storage slots of the listed components
+// by the Z-order of their entity's PositionComponent, so entities close in
+// space are close in memory as well. A plan is built once per cycle and
+// carried out `movesPerTick` slots at a time, entities created or removed
+// while it runs are picked up by the next cycle.
+//
+// Moving a component invalidates pointers to it, so paged components, whose
+// addresses are promised stable, cannot be listed; PositionComponent is only
+// read for the codes. Register it in its own stage, after which no pointer to
+// a reordered component from an earlier stage may be used.
+template<typename... Components>
+class MortonReorderSystem {
+private:
+    static_assert((!UsePagedStorage<Components>::value && ...),
+                  "Paged components keep their address and cannot be reordered.");
+
+    struct Column {
+        std::vector<EntityID> order;  // entities in Morton order
+        std::vector<size_t> slots;    // slots they occupied when planned, ascending
+        size_t cursor = 0;
+
+        bool done() const { return cursor == order.size(); }
+    };
+
+    size_t movesPerTick;
+    std::array<Column, sizeof...(Components)> columns;
+    std::vector<std::pair<uint32_t, EntityID>> codes;
+
+    // Offset along one axis scaled into the 16 bits a code holds, clamped
+    // before the cast, which is undefined out of range.
+    static uint32_t quantize(double offset, double scale) {
+        return static_cast<uint32_t>(std::clamp(offset * scale, 0.0, 65535.0));
+    }
+
+    static bool finite(const PositionComponent& position) {
+        return std::isfinite(position.x) && std::isfinite(position.y);
+    }
+
+    // Entities at a non-finite position get no code and keep their slots, as
+    // UniformGrid and LooseQuadTree leave them out of the broadphase.
+    void plan(ECS& ecs) {
+        const auto& entities = ecs.getEntitiesWithComponent<PositionComponent>().get();
+        if (entities.empty()) return;
+
+        float minX = std::numeric_limits<float>::max(), minY = minX;
+        float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+        for (const auto& entity : entities) {
+            const auto& position = *ecs.getComponent<PositionComponent>(entity);
+            if (!finite(position)) continue;
+            minX = std::min(minX, position.x);
+            minY = std::min(minY, position.y);
+            maxX = std::max(maxX, position.x);
+            maxY = std::max(maxY, position.y);
+        }
+        // In double, so an extent spanning the float range stays finite.
+        const double scaleX = 65535.0 / std::max(static_cast<double>(maxX) - minX, 1e-3);
+        const double scaleY = 65535.0 / std::max(static_cast<double>(maxY) - minY, 1e-3);
+
+        codes.clear();
+        for (const auto& entity : entities) {
+            const auto& position = *ecs.getComponent<PositionComponent>(entity);
+            if (!finite(position)) continue;
+            codes.emplace_back(mortonCode(quantize(static_cast<double>(position.x) - minX, scaleX),
+                                          quantize(static_cast<double>(position.y) - minY, scaleY)),
+                               entity);
+        }
+        std::sort(codes.begin(), codes.end());
+
+        size_t column = 0;
+        (planColumn<Components>(ecs, columns[column++]), ...);
+    }
+
+    template<typename T>
+    void planColumn(ECS& ecs, Column& column) {
+        column.order.clear();
+        column.slots.clear();
+        column.cursor = 0;
+        for (const auto& [code, entity] : codes) {
+            if (!ecs.entityStorage.hasComponent<T>(entity)) continue;
+            column.order.push_back(entity);
+            column.slots.push_back(ecs.entityStorage.getComponentIndex<T>(entity));
+        }
+        std::sort(column.slots.begin(), column.slots.end());
+    }
+
+    // The k-th entity in Morton order goes to the k-th lowest planned slot.
+    // Every move is a swap, so a stale plan only costs locality.
+    template<typename T>
+    static void applyColumn(ECS& ecs, Column& column, size_t& budget) {
+        while (budget > 0 && !column.done()) {
+            const auto step = column.cursor++;
+            if (!ecs.entityStorage.hasComponent<T>(column.order[step])) continue;
+            ecs.moveComponentToSlot<T>(column.order[step], column.slots[step]);
+            --budget;
+        }
+    }
+
+public:
+    explicit MortonReorderSystem(size_t movesPerTick = 256) : movesPerTick(movesPerTick) {}
+
+    void operator()(ECS& ecs, const float&, RenderingQueues&) {
+        const bool cycleDone = std::all_of(columns.begin(), columns.end(),
+                                           [](const Column& column) { return column.done(); });
+        if (cycleDone) plan(ecs);
+
+        size_t budget = movesPerTick;
+        size_t column = 0;
+        (applyColumn<Components>(ecs, columns[column++], budget), ...);
+    }
+};
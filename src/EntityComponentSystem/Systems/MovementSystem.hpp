@@ -1,9 +1,18 @@
 #pragma once
+#include <algorithm>
+
 #include "../ECS.hpp"
+#include "SimLodSystem.hpp"
 
-inline void movementSystem(ECS& ecs, const float& deltaTime, RenderingQueues& renderingQueues) {
-    auto entities = ecs.getEntitiesWithComponent<MovableComponent>().andHas<PositionComponent>().get();
+inline void movementSystem(ECS& ecs, const float& deltaTime, RenderingQueues&) {
+    const auto& entities = ecs.getEntitiesWithComponent<MovableComponent>()
+                               .andHas<PositionComponent>()
+                               .without<SleepingComponent>()
+                               .get();
     for (const auto& entity : entities) {
+        float step;
+        if (!simLodDue(ecs, entity, deltaTime, step)) continue;
+
         auto mComponent = ecs.getComponent<MovableComponent>(entity);
         auto pComponent = ecs.getComponent<PositionComponent>(entity);
 
@@ -15,10 +24,13 @@ inline void movementSystem(ECS& ecs, const float& deltaTime, RenderingQueues& re
             dx *= speed / actSpeed;
             dy *= speed / actSpeed;
         }
-        dx *= 1 - (2*deltaTime);
-        dy *= 1 - (2*deltaTime);
+        // Far LOD tiers step long enough to overshoot a linear decay, which
+        // would flip the velocity instead of stopping it.
+        const float damping = std::max(0.f, 1 - (2*step));
+        dx *= damping;
+        dy *= damping;
 
-        x += dx * deltaTime;
-        y += dy * deltaTime;
+        x += dx * step;
+        y += dy * step;
     }
 }
@@ -0,0 +1,85 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NARROWPHASE_SSE2 1
+#endif
+
+#include "CollisionProxies.hpp"
+
+// Broadphase candidates of one proxy, copied into packed arrays so the
+// circle tests run over contiguous memory, eight per iteration with SSE2.
+// The arrays are padded to a whole iteration with NaN circles, which never
+// overlap anything. A batch keeps its capacity between proxies and passes;
+// every thread needs its own.
+class NarrowphaseBatch {
+private:
+    static constexpr size_t width = 8;
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> r;
+    std::vector<uint32_t> found;  // candidate positions that overlap, in order
+    size_t count = 0;
+
+public:
+    std::vector<uint32_t> candidates;  // proxy indices
+
+    void clear() {
+        candidates.clear();
+        x.clear();
+        y.clear();
+        r.clear();
+        count = 0;
+    }
+
+    void add(const CollisionProxies& proxies, uint32_t j) {
+        candidates.push_back(j);
+        x.push_back(proxies.x[j]);
+        y.push_back(proxies.y[j]);
+        r.push_back(proxies.r[j]);
+        ++count;
+    }
+
+    // Tests every candidate against the circle (cx, cy, cr) with the same
+    // arithmetic as collide(), and returns the overlapping candidate
+    // positions in the order they were added.
+    const std::vector<uint32_t>& overlapping(float cx, float cy, float cr) {
+        found.clear();
+        const size_t padded = (count + width - 1) / width * width;
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        x.resize(padded, nan);
+        y.resize(padded, nan);
+        r.resize(padded, nan);
+
+#ifdef NARROWPHASE_SSE2
+        const __m128 px = _mm_set1_ps(cx);
+        const __m128 py = _mm_set1_ps(cy);
+        const __m128 pr = _mm_set1_ps(cr);
+        auto test = [&](size_t k) {
+            const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&x[k]), px);
+            const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&y[k]), py);
+            const __m128 reach = _mm_add_ps(pr, _mm_loadu_ps(&r[k]));
+            const __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(distance, _mm_mul_ps(reach, reach))));
+        };
+        for (size_t k = 0; k < padded; k += width) {
+            for (uint32_t bits = test(k) | test(k + 4) << 4; bits != 0; bits &= bits - 1) {
+                found.push_back(static_cast<uint32_t>(k) + std::countr_zero(bits));
+            }
+        }
+#else
+        for (size_t k = 0; k < count; ++k) {
+            const float dx = x[k] - cx;
+            const float dy = y[k] - cy;
+            const float reach = cr + r[k];
+            if (dx * dx + dy * dy < reach * reach) found.push_back(static_cast<uint32_t>(k));
+        }
+#endif
+        return found;
+    }
+};
@@ -1,103 +1,126 @@
 #pragma once
-#include <thread>
-#include <mutex>
+#include <algorithm>
 #include <vector>
-#include <cmath>
-#include "../ECS.hpp"
-#include "QuadTree.hpp"
-
-inline bool collide(const float& aX, const float& aY, const float& aR,
-                    const float& bX, const float& bY, const float& bR) {
-    return (bX - aX) * (bX - aX) + (bY - aY) * (bY - aY) < (aR + bR) * (aR + bR);
-}
-
-constexpr float repulsive_force = 3.f;
-
-inline void collidingSystem(ECS& ecs, const float& deltaTime, RenderingQueues& renderingQueues) {
-    auto entitiesSet = ecs.getEntitiesWithComponent<CollidingComponent>()
-                          .andHas<PositionComponent>().get();
-
-    std::vector<EntityID> entities(entitiesSet.begin(), entitiesSet.end());
-
-    AABB worldBounds{0.f, 0.f, 500.f, 500.f};
-    QuadTree quadTree(worldBounds);
-
-    for (auto entity : entities) {
-        auto pos = ecs.getComponent<PositionComponent>(entity);
-        if (pos) quadTree.insert(entity, pos->x, pos->y);
-    }
 
-    struct Vec2 { float x=0.f, y=0.f; };
-    std::unordered_map<EntityID, Vec2> displacements;
-    std::mutex dispMutex;
-
-    auto worker = [&](size_t start, size_t end) {
-        for (size_t i = start; i < end; ++i) {
-            EntityID entity = entities[i];
-            auto posA = ecs.getComponent<PositionComponent>(entity);
-            auto colA = ecs.getComponent<CollidingComponent>(entity);
-            if (!posA || !colA) continue;
-
-            bool movableA = ecs.entityStorage.hasComponent<MovableComponent>(entity);
-
-            AABB range{posA->x, posA->y, colA->r, colA->r};
-            std::vector<EntityID> nearby;
-            quadTree.query(range, nearby);
-
-            for (auto other : nearby) {
-                if (other <= entity) continue;
-
-                auto posB = ecs.getComponent<PositionComponent>(other);
-                auto colB = ecs.getComponent<CollidingComponent>(other);
-                if (!posB || !colB) continue;
+#include "../../ThreadPool/ThreadPool.hpp"
+#include "../ECS.hpp"
+#include "CollidingSystem.hpp"
+#include "CollisionResolutionSystem.hpp"
+
+// Collision detection and separation in one pass on gThreadPool, replacing
+// CollidingSystem followed by collisionResolutionSystem; contactRulesSystem
+// then runs the gameplay side of the contacts. Everything the workers read is
+// gathered into flat arrays first, so they never touch component storage.
+// Contacts are found in parallel, carried into ecs.contactPairs on the
+// calling thread, and then resolved by the task that found them, so each
+// cached pair is written by one task. Each task records the displacements of
+// the slots it pushes, and they are applied in task order, so the reduction
+// costs one step per push rather than one per proxy and task. Only sources
+// are split into tasks, and the split depends only on their number, so
+// results do not depend on the number of threads.
+template<typename Broadphase>
+class ParallelCollidingSystem {
+private:
+    static constexpr size_t sources_per_task = 512;
+    static constexpr size_t max_tasks = 16;
+
+    // Contact of proxy i with proxy j that pushes them apart.
+    struct Push {
+        uint32_t contact;  // index into TaskOutput::contacts
+        uint32_t i, j;
+    };
 
-                bool movableB = ecs.entityStorage.hasComponent<MovableComponent>(other);
+    // Displacement of the proxy in `slot` by one push.
+    struct Move {
+        uint32_t slot;
+        float dx, dy;
+    };
 
-                float dx = posB->x - posA->x;
-                float dy = posB->y - posA->y;
-                float distSq = dx*dx + dy*dy;
-                float dist = std::sqrt(distSq);
-                if (dist == 0.f) { dx = 1.f; dy = 0.f; dist = 1.f; }
+    struct TaskOutput {
+        std::vector<Contact> contacts;  // normals point from i to j
+        std::vector<Push> pushes;
+        NarrowphaseBatch batch;
+        std::vector<Move> moves;  // in push order
+    };
 
-                float overlap = (colA->r + colB->r - dist);
-                if (overlap > 0.f) {
-                    float nx = dx / dist;
-                    float ny = dy / dist;
-                    float pushA = movableA ? 0.5f * overlap : 0.f;
-                    float pushB = movableB ? 0.5f * overlap : 0.f;
+    CollisionProxies proxies;
+    std::vector<ComponentBitMask> masks;
+    std::vector<PositionComponent*> positions;
+    Broadphase broadphase;
+    std::vector<TaskOutput> outputs;
+
+public:
+    void operator()(ECS& ecs, const float& deltaTime, RenderingQueues&) {
+        const auto& entities = ecs.getEntitiesWithComponent<HitBoxComponent>().andHas<PositionComponent>().get();
+
+        proxies.clear();
+        masks.clear();
+        positions.clear();
+        for (auto entity : entities) {
+            auto* pos = ecs.getComponent<PositionComponent>(entity);
+            const auto& col = *ecs.getComponent<HitBoxComponent>(entity);
+            addCollisionProxy(ecs, proxies, entity, *pos, col.r, collisionSource(ecs, entity, deltaTime));
+            masks.push_back(ecs.entityStorage.getComponentMask(entity));
+            positions.push_back(pos);
+        }
+        broadphase.build(proxies);
+        if constexpr (requires { broadphase.stats(); }) {
+            ecs.resource<BroadphaseStats>() = broadphase.stats();
+        }
 
-                    Vec2 dispA{ -nx * pushA, -ny * pushA };
-                    Vec2 dispB{  nx * pushB,  ny * pushB };
+        // Tasks split the sources only, so sleeping islands cost no task time.
+        const size_t count = proxies.sources.size();
+        const size_t tasks = std::clamp<size_t>(count / sources_per_task, 1, max_tasks);
+        const size_t chunk = (count + tasks - 1) / tasks;
+        outputs.resize(tasks);
+
+        gThreadPool.parallelFor(tasks, [&](size_t task) {
+            auto& output = outputs[task];
+            output.contacts.clear();
+            output.pushes.clear();
+
+            const size_t end = std::min(count, (task + 1) * chunk);
+            for (size_t s = task * chunk; s < end; ++s) {
+                const uint32_t i = proxies.sources[s];
+                collideProxy(proxies, broadphase, i, output.batch, [&](uint32_t j, float nx, float ny, float depth) {
+                    if (pushesApart(masks[i], masks[j])) {
+                        output.pushes.push_back({static_cast<uint32_t>(output.contacts.size()),
+                                                 i, j});
+                    }
+                    output.contacts.push_back({proxies.ids[i], proxies.ids[j], nx, ny, depth});
+                });
+            }
+        });
 
-                    std::lock_guard<std::mutex> lock(dispMutex);
-                    displacements[entity].x += dispA.x;
-                    displacements[entity].y += dispA.y;
-                    displacements[other].x += dispB.x;
-                    displacements[other].y += dispB.y;
-                }
+        ecs.contacts.clear();
+        for (const auto& output : outputs) {
+            for (const auto& contact : output.contacts) {
+                ecs.contacts.emit(contact.a, contact.b, contact.nx, contact.ny, contact.depth);
             }
         }
-    };
-
-    size_t numThreads = std::thread::hardware_concurrency();
-    if (numThreads == 0) numThreads = 4;
-    std::vector<std::thread> threads;
-    size_t chunkSize = (entities.size() + numThreads - 1) / numThreads;
-
-    for (size_t t = 0; t < numThreads; ++t) {
-        size_t start = t * chunkSize;
-        size_t end = std::min(start + chunkSize, entities.size());
-        threads.emplace_back(worker, start, end);
-    }
-
-    for (auto& th : threads) th.join();
-
-    for (auto& [entity, disp] : displacements) {
-        auto pos = ecs.getComponent<PositionComponent>(entity);
-        if (!pos) continue;
-        if (!ecs.entityStorage.hasComponent<MovableComponent>(entity)) continue;
+        ecs.contacts.sortByEntity();
+        updateContactPairs(ecs, deltaTime);
+
+        gThreadPool.parallelFor(tasks, [&](size_t task) {
+            auto& output = outputs[task];
+            output.moves.clear();
+            for (const auto& [index, i, j] : output.pushes) {
+                const auto& contact = output.contacts[index];
+                const bool movableI = maskHas<MovableComponent>(masks[i]);
+                const bool movableJ = maskHas<MovableComponent>(masks[j]);
+                const float push = contactPush(ecs.contactPairs.find(contact.a, contact.b), contact.depth,
+                                               movableI && movableJ);
+                if (movableI) output.moves.push_back({i, -contact.nx * push, -contact.ny * push});
+                if (movableJ) output.moves.push_back({j, contact.nx * push, contact.ny * push});
+            }
+        });
 
-        pos->x += disp.x;
-        pos->y += disp.y;
+        // Only the slots some task pushed are touched, in the same order every run.
+        for (const auto& output : outputs) {
+            for (const auto& [slot, dx, dy] : output.moves) {
+                positions[slot]->x += dx;
+                positions[slot]->y += dy;
+            }
+        }
     }
-}
+};
@@ -1,30 +1,31 @@
 #pragma once
 #include "../ECS.hpp"
-#include "../../InputHandler/InputHandler.hpp"
+#include "../Resources/InputState.hpp"
 
-inline void playerMovementSystem(ECS& ecs, const float& deltaTime, RenderingQueues& renderingQueues) {
+inline void playerMovementSystem(ECS& ecs, const float& deltaTime, RenderingQueues&) {
     auto entities = ecs.getEntitiesWithComponent<PlayerMovementComponent>().andHas<MovableComponent>().get();
+    const auto& input = ecs.resource<InputState>();
     for (const auto& entity : entities) {
         auto mComponent = ecs.getComponent<MovableComponent>(entity);
 
         auto& [dx, dy, speed, acceleration] = *mComponent;
 
-        if (gInputHandler.isPressed(Key::W) ^ gInputHandler.isPressed(Key::S)) {
-            if (gInputHandler.isPressed(Key::W)) {
+        if (input.isPressed(Key::W) ^ input.isPressed(Key::S)) {
+            if (input.isPressed(Key::W)) {
                 dy += -acceleration * speed * deltaTime;
             }
-            if (gInputHandler.isPressed(Key::S)) {
+            if (input.isPressed(Key::S)) {
                 dy += acceleration * speed * deltaTime;
             }
         }
         else
             dy *= 1 - (acceleration * deltaTime);
 
-        if (gInputHandler.isPressed(Key::A) ^ gInputHandler.isPressed(Key::D)) {
-            if (gInputHandler.isPressed(Key::A)) {
+        if (input.isPressed(Key::A) ^ input.isPressed(Key::D)) {
+            if (input.isPressed(Key::A)) {
                 dx += acceleration * speed * deltaTime;
             }
-            if (gInputHandler.isPressed(Key::D)) {
+            if (input.isPressed(Key::D)) {
                 dx += -acceleration * speed * deltaTime;
             }
         }
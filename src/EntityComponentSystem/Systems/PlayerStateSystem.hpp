@@ -0,0 +1,14 @@
+#pragma once
+#include "../ECS.hpp"
+#include "../Resources/PlayerState.hpp"
+
+inline void playerStateSystem(ECS& ecs, const float&, RenderingQueues&) {
+    auto& player = ecs.resource<PlayerState>();
+    auto* position = ecs.getComponent<PositionComponent>(player.entity);
+    player.alive = position != nullptr && ecs.entityStorage.hasComponent<PlayerMovementComponent>(player.entity);
+    if (!player.alive) return;
+
+    player.x = position->x;
+    player.y = position->y;
+    player.z = position->z;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "../ECS.hpp"
+
+// Runs first in every tick so PreviousPositionComponent holds the state the
+// renderer interpolates from.
+inline void previousPositionSystem(ECS& ecs, const float&, RenderingQueues&) {
+    const auto& entities = ecs.getEntitiesWithComponent<PreviousPositionComponent>().andHas<PositionComponent>().get();
+    for (const auto& entity : entities) {
+        auto& [x, y, z] = *ecs.getComponent<PositionComponent>(entity);
+        *ecs.getComponent<PreviousPositionComponent>(entity) = {x, y, z};
+    }
+}
@@ -1,8 +1,14 @@
 #pragma once
-#include <vector>
-#include <memory>
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "../../ThreadPool/ThreadPool.hpp"
 #include "../Storage/EntityStorage.hpp"
+#include "CollisionProxies.hpp"
 
 struct AABB {
     float x, y;    // center
@@ -21,61 +27,234 @@ struct AABB {
     }
 };
 
-class QuadTree {
-    static constexpr int CAPACITY = 4;
-    AABB boundary;
-    std::vector<EntityID> entities;
-    bool divided = false;
-
-    std::unique_ptr<QuadTree> northeast, northwest, southeast, southwest;
+// Quadtree stored as flat arrays. Points are sorted by the Morton code of
+// their quantized position, so every node is a contiguous range of the sorted
+// points sharing a code prefix and the hierarchy follows from splitting
+// ranges on the next two bits. Codes are computed and radix sorted on
+// gThreadPool; nothing is allocated per node and the arrays keep their
+// capacity between builds.
+class LinearQuadTree {
+private:
+    static constexpr uint32_t LEAF_CAPACITY = 16;
+    static constexpr uint32_t MAX_DEPTH = 16;  // bits per axis of the codes
+    static constexpr uint32_t npos = UINT32_MAX;
+    static constexpr size_t RADIX_BITS = 8;
+    static constexpr size_t RADIX_BUCKETS = size_t{1} << RADIX_BITS;
+    static constexpr size_t MIN_TASK_SIZE = 4096;
 
-public:
-    QuadTree(const AABB& boundary) : boundary(boundary) {}
+    struct Node {
+        float minX, minY, size;  // square cell
+        uint32_t begin, end;     // range of sorted points
+        uint32_t firstChild;     // npos for leaves
+        uint8_t childCount;
+        uint8_t depth;
+    };
 
-    void subdivide() {
-        float x = boundary.x;
-        float y = boundary.y;
-        float hw = boundary.halfW / 2.f;
-        float hh = boundary.halfH / 2.f;
+    std::vector<uint64_t> keys;  // Morton code in the high half, proxy index in the low half
+    std::vector<uint64_t> scratch;
+    std::vector<std::array<uint32_t, RADIX_BUCKETS>> histograms;  // one per sort task
+    std::vector<float> xs;        // sorted point positions
+    std::vector<float> ys;
+    std::vector<uint32_t> indices;  // sorted proxy indices
+    std::vector<EntityID> ids;      // sorted entity ids
+    std::vector<Node> nodes;
+    float quantum = 0.0f;
+    float maxRadius = 0.0f;
 
-        northeast = std::make_unique<QuadTree>(AABB{x + hw, y - hh, hw, hh});
-        northwest = std::make_unique<QuadTree>(AABB{x - hw, y - hh, hw, hh});
-        southeast = std::make_unique<QuadTree>(AABB{x + hw, y + hh, hw, hh});
-        southwest = std::make_unique<QuadTree>(AABB{x - hw, y + hh, hw, hh});
+    static uint32_t spread(uint32_t v) {
+        v &= 0x0000ffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    }
 
-        divided = true;
+    static bool finite(const CollisionProxies& proxies, size_t i) {
+        return std::isfinite(proxies.x[i]) && std::isfinite(proxies.y[i]) && std::isfinite(proxies.r[i]);
     }
 
-    bool insert(EntityID id, float x, float y) {
-        if (!boundary.contains(x, y)) return false;
+    static uint32_t code(uint64_t key) { return static_cast<uint32_t>(key >> 32); }
 
-        if (entities.size() < CAPACITY) {
-            entities.push_back(id);
-            return true;
-        }
+    // Stable LSD radix sort of `keys` by their code, one byte per pass. Each
+    // task histograms and later scatters its own chunk, so passes stay stable.
+    void sortKeys() {
+        const size_t count = keys.size();
+        const size_t tasks = std::clamp<size_t>(count / MIN_TASK_SIZE, 1, gThreadPool.concurrency());
+        const size_t chunk = (count + tasks - 1) / tasks;
+        histograms.resize(tasks);
+        scratch.resize(count);
+
+        for (size_t shift = 32; shift < 64; shift += RADIX_BITS) {
+            auto digit = [shift](uint64_t key) { return (key >> shift) & (RADIX_BUCKETS - 1); };
 
-        if (!divided) subdivide();
+            gThreadPool.parallelFor(tasks, [&](size_t task) {
+                auto& histogram = histograms[task];
+                histogram.fill(0);
+                const size_t end = std::min(count, (task + 1) * chunk);
+                for (size_t i = task * chunk; i < end; ++i) ++histogram[digit(keys[i])];
+            });
 
-        if (northeast->insert(id, x, y)) return true;
-        if (northwest->insert(id, x, y)) return true;
-        if (southeast->insert(id, x, y)) return true;
-        if (southwest->insert(id, x, y)) return true;
+            // Offsets ordered by digit first and task second.
+            uint32_t running = 0;
+            bool trivial = false;
+            for (size_t d = 0; d < RADIX_BUCKETS; ++d) {
+                const uint32_t before = running;
+                for (auto& histogram : histograms) {
+                    const uint32_t amount = histogram[d];
+                    histogram[d] = running;
+                    running += amount;
+                }
+                trivial |= running - before == count;
+            }
+            if (trivial) continue;  // every key has this digit
 
-        return false;
+            gThreadPool.parallelFor(tasks, [&](size_t task) {
+                auto& offsets = histograms[task];
+                const size_t end = std::min(count, (task + 1) * chunk);
+                for (size_t i = task * chunk; i < end; ++i) scratch[offsets[digit(keys[i])]++] = keys[i];
+            });
+            std::swap(keys, scratch);
+        }
     }
 
-    void query(const AABB& range, std::vector<EntityID>& found) const {
-        if (!boundary.intersects(range)) return;
+    // Splits nodes breadth first. The node vector doubles as the queue.
+    void buildNodes(float originX, float originY, float extent) {
+        nodes.clear();
+        nodes.push_back({originX, originY, extent, 0, static_cast<uint32_t>(keys.size()), npos, 0, 0});
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            const Node node = nodes[n];
+            if (node.end - node.begin <= LEAF_CAPACITY || node.depth == MAX_DEPTH) continue;
 
-        for (auto id : entities) {
-            found.push_back(id);
+            const uint32_t shift = 2 * (MAX_DEPTH - node.depth - 1);
+            const float half = node.size * 0.5f;
+            nodes[n].firstChild = static_cast<uint32_t>(nodes.size());
+            uint32_t begin = node.begin;
+            for (uint32_t quadrant = 0; quadrant < 4; ++quadrant) {
+                const auto end = static_cast<uint32_t>(
+                    std::partition_point(keys.begin() + begin, keys.begin() + node.end,
+                                         [&](uint64_t key) { return ((code(key) >> shift) & 3) <= quadrant; }) -
+                    keys.begin());
+                if (end == begin) continue;
+                nodes.push_back({node.minX + (quadrant & 1) * half, node.minY + (quadrant >> 1) * half, half,
+                                 begin, end, npos, 0, static_cast<uint8_t>(node.depth + 1)});
+                ++nodes[n].childCount;
+                begin = end;
+            }
         }
+    }
 
-        if (divided) {
-            northeast->query(range, found);
-            northwest->query(range, found);
-            southeast->query(range, found);
-            southwest->query(range, found);
+    bool overlaps(const Node& node, const AABB& range) const {
+        return !(range.x - range.halfW > node.minX + node.size + quantum ||
+                 range.x + range.halfW < node.minX - quantum ||
+                 range.y - range.halfH > node.minY + node.size + quantum ||
+                 range.y + range.halfH < node.minY - quantum);
+    }
+
+    // Calls `visit` with the sorted position of every point inside `range`.
+    template<typename Visit>
+    void visitRange(const AABB& range, Visit&& visit) const {
+        if (nodes.empty()) return;
+        // Each level pushes at most four children and pops one.
+        std::array<uint32_t, 4 * (MAX_DEPTH + 1)> stack;
+        size_t top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!overlaps(node, range)) continue;
+            if (node.firstChild == npos) {
+                for (uint32_t k = node.begin; k < node.end; ++k) {
+                    if (range.contains(xs[k], ys[k])) visit(k);
+                }
+                continue;
+            }
+            for (uint32_t child = 0; child < node.childCount; ++child) {
+                stack[top++] = node.firstChild + child;
+            }
         }
     }
+
+public:
+    // Proxies with a non-finite position or radius are left out, as
+    // LooseQuadTree::build does; queries from them visit nothing.
+    void build(const CollisionProxies& proxies) {
+        keys.clear();
+        nodes.clear();
+        maxRadius = 0.0f;
+
+        // Bounds in double, so a world spanning the float range does not
+        // overflow its own extent.
+        double minX = 0.0, maxX = 0.0, minY = 0.0, maxY = 0.0;
+        for (size_t i = 0; i < proxies.size(); ++i) {
+            if (!finite(proxies, i)) continue;
+            const double x = proxies.x[i];
+            const double y = proxies.y[i];
+            minX = keys.empty() ? x : std::min(minX, x);
+            maxX = keys.empty() ? x : std::max(maxX, x);
+            minY = keys.empty() ? y : std::min(minY, y);
+            maxY = keys.empty() ? y : std::max(maxY, y);
+            maxRadius = std::max(maxRadius, proxies.r[i]);
+            keys.push_back(i);
+        }
+        const size_t count = keys.size();
+        if (count == 0) return;
+
+        const float originX = static_cast<float>(minX);
+        const float originY = static_cast<float>(minY);
+        const double extent = std::max({maxX - minX, maxY - minY, 1e-3});
+        const double scale = 65536.0 / extent;
+        quantum = static_cast<float>(extent / 65536.0);
+
+        xs.resize(count);
+        ys.resize(count);
+        indices.resize(count);
+        ids.resize(count);
+
+        // Clamped in double before the cast, which is undefined out of range.
+        auto quantize = [scale](double offset) {
+            return static_cast<uint32_t>(std::clamp(offset * scale, 0.0, 65535.0));
+        };
+        const size_t tasks = std::clamp<size_t>(count / MIN_TASK_SIZE, 1, gThreadPool.concurrency());
+        const size_t chunk = (count + tasks - 1) / tasks;
+        gThreadPool.parallelFor(tasks, [&](size_t task) {
+            const size_t end = std::min(count, (task + 1) * chunk);
+            for (size_t k = task * chunk; k < end; ++k) {
+                const auto i = static_cast<uint32_t>(keys[k]);
+                const auto qx = quantize(proxies.x[i] - minX);
+                const auto qy = quantize(proxies.y[i] - minY);
+                keys[k] |= static_cast<uint64_t>(spread(qx) | (spread(qy) << 1)) << 32;
+            }
+        });
+        sortKeys();
+
+        gThreadPool.parallelFor(tasks, [&](size_t task) {
+            const size_t end = std::min(count, (task + 1) * chunk);
+            for (size_t k = task * chunk; k < end; ++k) {
+                const auto i = static_cast<uint32_t>(keys[k]);
+                indices[k] = i;
+                xs[k] = proxies.x[i];
+                ys[k] = proxies.y[i];
+                ids[k] = proxies.ids[i];
+            }
+        });
+        buildNodes(originX, originY, static_cast<float>(std::min<double>(extent, std::numeric_limits<float>::max())));
+    }
+
+    // Calls `visit` with the proxy index of every point inside `range`.
+    template<typename Visit>
+    void forEachInRange(const AABB& range, Visit&& visit) const {
+        visitRange(range, [&](uint32_t k) { visit(indices[k]); });
+    }
+
+    void query(const AABB& range, std::vector<EntityID>& found) const {
+        visitRange(range, [&](uint32_t k) { found.push_back(ids[k]); });
+    }
+
+    // Broadphase interface of CollidingSystem.
+    template<typename Visit>
+    void query(const CollisionProxies& proxies, size_t index, Visit&& visit) const {
+        if (!finite(proxies, index)) return;
+        const float reach = proxies.r[index] + maxRadius;
+        forEachInRange(AABB{proxies.x[index], proxies.y[index], reach, reach}, visit);
+    }
 };
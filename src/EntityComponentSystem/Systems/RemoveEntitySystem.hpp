@@ -1,10 +1,26 @@
 #pragma once
 #include "../ECS.hpp"
 
-inline void removeEntitySystem(ECS& ecs, const float& deltaTime, RenderingQueues& renderingQueues) {
-    auto entities = ecs.getEntitiesWithComponent<RemoveComponent>().get();
-
+// Registered with ecs.onAdd<RemoveComponent>(), tagged entities are destroyed
+// in one batch when the stage that tagged them is flushed. Pooled entities go
+// back to their pool instead.
+inline void removeEntityObserver(ECS& ecs, std::span<const EntityID> entities) {
     for (const auto& entity : entities) {
-        ecs.removeEntity(entity);
+        if (!ecs.entityStorage.hasComponent<PooledComponent>(entity)) {
+            ecs.removeEntity(entity);
+            continue;
+        }
+        // Dropping the tag after deactivation touches no query, and lets the
+        // next tag on the recycled entity notify this observer again.
+        ecs.despawn(entity);
+        ecs.removeComponent<RemoveComponent>(entity);
     }
 }
+
+// Timer action tagging the entity for removal, see TimerWheel. Entities
+// destroyed before the timer fires are skipped.
+inline void expireEntityAction(CommandBuffer& commands, EntityID entity) {
+    commands.push([entity](ECS& ecs) {
+        if (ecs.entityStorage.hasEntity(entity)) ecs.addComponent(entity, RemoveComponent{});
+    });
+}
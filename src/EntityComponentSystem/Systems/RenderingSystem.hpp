@@ -3,49 +3,96 @@
 #include <glm/glm.hpp>
 
 #include "../ECS.hpp"
+#include "../Resources/PlayerState.hpp"
 #include "../Components/MovableComponent.hpp"
 #include "../Components/RenderableComponent.hpp"
 
-inline void renderingSystem(ECS& ecs, const float& deltaTime, RenderingQueues& renderingQueues) {
-    auto entities = ecs.getEntitiesWithComponent<PositionComponent>().get();
-    auto player = ecs.getEntitiesWithComponent<PlayerMovementComponent>().get();
-
-    PositionComponent* playerPos = nullptr;
-    if (player.size() == 1) {
-        playerPos = ecs.getComponent<PositionComponent>(*player.begin());
+inline bool interpolatedPosition(ECS& ecs, EntityID entity, bool hasPrevious, const float& alpha,
+                                 const PlayerState* playerPos, glm::vec3& out) {
+    auto [x, y, z] = *ecs.getComponent<PositionComponent>(entity);
+    if (hasPrevious) {
+        auto* previous = ecs.getComponent<PreviousPositionComponent>(entity);
+        x = glm::mix(previous->x, x, alpha);
+        y = glm::mix(previous->y, y, alpha);
+        z = glm::mix(previous->z, z, alpha);
     }
 
-    for (const auto& entity : entities) {
-        auto position = ecs.getComponent<PositionComponent>(entity);
-        auto& [x, y, z] = *position;
-
-        if (playerPos) {
-            float dx = x - playerPos->x;
-            float dy = y - playerPos->y;
-            float distanceXY = std::sqrt(dx * dx + dy * dy);
-            if (distanceXY > 50.0f) {
-                continue;
-            }
+    if (playerPos) {
+        float dx = x - playerPos->x;
+        float dy = y - playerPos->y;
+        float distanceXY = std::sqrt(dx * dx + dy * dy);
+        if (distanceXY > 50.0f) {
+            return false;
         }
+    }
+    out = glm::vec3(x, y, z);
+    return true;
+}
+
+template <typename Vertex, typename Material>
+inline glm::mat4 modelMatrixFor(const RenderableComponent<Vertex, Material>& mesh, const glm::vec3& position) {
+    glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position);
+    modelMatrix = glm::rotate(modelMatrix, mesh.rotation, mesh.rotation_along);
+    return glm::scale(modelMatrix, mesh.scale);
+}
 
-        if (auto* coloredMesh = ecs.getComponent<RenderableColored>(entity)) {
-            glm::vec3 scaleVec = coloredMesh->scale;;
-            glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
-            modelMatrix = glm::rotate(modelMatrix, coloredMesh->rotation, coloredMesh->rotation_along);
-            modelMatrix = glm::scale(modelMatrix, scaleVec);
-            auto draw = coloredMesh->withTransform(modelMatrix);
-            renderingQueues.coloredQueue->emplace_back(draw);
+template <typename Vertex, typename Material>
+inline void queueRenderables(ECS& ecs, const std::unordered_map<EntityID, ComponentBitMask>& entities,
+                             const float& alpha, const PlayerState* playerPos,
+                             DrawQueue<Vertex, Material>& queue) {
+    for (const auto& [entity, optional] : entities) {
+        glm::vec3 position;
+        if (!interpolatedPosition(ecs, entity, maskHas<PreviousPositionComponent>(optional), alpha, playerPos, position)) {
             continue;
         }
 
-        if (auto* unlitMesh = ecs.getComponent<RenderableUnlit>(entity)) {
-            glm::vec3 scaleVec = unlitMesh->scale;;
-            glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
-            modelMatrix = glm::rotate(modelMatrix, unlitMesh->rotation, unlitMesh->rotation_along);
-            modelMatrix = glm::scale(modelMatrix, scaleVec);
-            auto draw = unlitMesh->withTransform(modelMatrix);
-            renderingQueues.unlitQueue->emplace_back(draw);
-            continue;
+        auto* mesh = ecs.getComponent<RenderableComponent<Vertex, Material>>(entity);
+        queue.emplace_back(mesh->withTransform(modelMatrixFor(*mesh, position)));
+    }
+}
+
+// Draws of one shared value are queued back to back, the renderable itself
+// is read once per group instead of once per entity. Despawned pooled
+// entities keep their place in the groups and are skipped here.
+template <typename Vertex, typename Material>
+inline void queueSharedRenderables(ECS& ecs, const float& alpha, const PlayerState* playerPos,
+                                   DrawQueue<Vertex, Material>& queue) {
+    for (const auto& [mesh, entities] : ecs.getSharedGroups<RenderableComponent<Vertex, Material>>()) {
+        auto partial = mesh.partial;
+        for (const auto& entity : entities) {
+            if (!ecs.entityStorage.isActive(entity)) continue;
+            const auto& mask = ecs.entityStorage.getComponentMask(entity);
+            if (!maskHas<PositionComponent>(mask)) continue;
+
+            glm::vec3 position;
+            if (!interpolatedPosition(ecs, entity, maskHas<PreviousPositionComponent>(mask), alpha, playerPos, position)) {
+                continue;
+            }
+            queue.emplace_back(partial.withTransform(modelMatrixFor(mesh, position)));
         }
     }
 }
+
+// Registered with addRenderSystem(), `alpha` blends from the previous tick's
+// position to the current one for entities that track it.
+inline void renderingSystem(ECS& ecs, const float& alpha, RenderingQueues& renderingQueues) {
+    const auto& player = ecs.resource<PlayerState>();
+    const PlayerState* playerPos = player.alive ? &player : nullptr;
+
+    const auto& colored = ecs.getEntitiesWithComponent<PositionComponent>()
+                              .andHas<RenderableColored>()
+                              .optional<PreviousPositionComponent>()
+                              .getWithOptional();
+    queueRenderables(ecs, colored, alpha, playerPos, *renderingQueues.coloredQueue);
+
+    // Colored wins when an entity carries both renderables.
+    const auto& unlit = ecs.getEntitiesWithComponent<PositionComponent>()
+                            .andHas<RenderableUnlit>()
+                            .without<RenderableColored>()
+                            .optional<PreviousPositionComponent>()
+                            .getWithOptional();
+    queueRenderables(ecs, unlit, alpha, playerPos, *renderingQueues.unlitQueue);
+
+    queueSharedRenderables(ecs, alpha, playerPos, *renderingQueues.coloredQueue);
+    queueSharedRenderables(ecs, alpha, playerPos, *renderingQueues.unlitQueue);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "../ECS.hpp"
+#include "../Resources/PlayerState.hpp"
+#include "../Resources/SimLod.hpp"
+
+// Re-buckets entities by distance to the player. Tiers change slowly, so
+// this is registered with a budget and walks the query over several ticks.
+inline void simLodTierSystem(ECS& ecs, const float&, RenderingQueues&) {
+    const auto& entities = ecs.getEntitiesWithComponent<SimLodComponent>().andHas<PositionComponent>().get();
+    const auto& player = ecs.resource<PlayerState>();
+    if (!player.alive) return;
+    const auto& lod = ecs.resource<SimLod>();
+
+    for (auto entity : ecs.budgetedSlice(entities)) {
+        auto* position = ecs.getComponent<PositionComponent>(entity);
+        auto* simLod = ecs.getComponent<SimLodComponent>(entity);
+        if (position == nullptr || simLod == nullptr) continue;
+
+        const float dx = position->x - player.x;
+        const float dy = position->y - player.y;
+        const float distanceSq = dx * dx + dy * dy;
+        uint8_t tier = 0;
+        while (tier < lod.tierDistances.size() &&
+               distanceSq > lod.tierDistances[tier] * lod.tierDistances[tier]) {
+            ++tier;
+        }
+        simLod->tier = tier;
+    }
+}
+
+// Decides which entities simulate this tick. Updates of a tier are staggered
+// by entity id, so a far tier costs the same every tick instead of spiking.
+inline void simLodScheduleSystem(ECS& ecs, const float& deltaTime, RenderingQueues&) {
+    const auto& entities = ecs.getEntitiesWithComponent<SimLodComponent>().get();
+    auto& lod = ecs.resource<SimLod>();
+    ++lod.tick;
+
+    for (auto entity : entities) {
+        auto& simLod = *ecs.getComponent<SimLodComponent>(entity);
+        simLod.elapsed += deltaTime;
+        const auto interval = lod.tierIntervals[simLod.tier];
+        simLod.due = (lod.tick + entity) % interval == 0;
+        if (simLod.due) {
+            simLod.step = simLod.elapsed;
+            simLod.elapsed = 0.0f;
+        }
+    }
+}
+
+// Whether `entity` simulates this tick and the delta time to use for it.
+inline bool simLodDue(ECS& ecs, EntityID entity, const float& deltaTime, float& step) {
+    auto* simLod = ecs.getComponent<SimLodComponent>(entity);
+    if (simLod == nullptr) {
+        step = deltaTime;
+        return true;
+    }
+    step = simLod->step;
+    return simLod->due;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../ECS.hpp"
+#include "SimLodSystem.hpp"
+
+constexpr float sleep_speed_threshold = 0.2f;        // units per second of displacement
+constexpr float sleep_wake_velocity_change = 0.5f;   // units per second
+constexpr uint16_t sleep_ticks = 30;
+
+// Runs after collision resolution. Entities touching each other form an
+// island, which falls asleep once all its members have stayed still for
+// `sleep_ticks` simulated ticks and wakes as a whole when any member moves,
+// its steering changes, or an awake movable body without sleep state touches
+// it. Static bodies count as resting, so a pile pressed against a wall still
+// falls asleep. Sleeping bodies do not look for contacts among themselves, so
+// a wake spreads through a resting pile one contact layer per tick. Islands
+// are a union-find over flat arrays indexed by each member's slot this tick.
+class SleepSystem {
+private:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    std::vector<EntityID> members;
+    std::vector<uint32_t> parent;
+    std::vector<uint8_t> islandStill;
+
+    uint32_t slotOf(EntityID entity, const SleepStateComponent* sleep) const {
+        if (sleep == nullptr || sleep->slot >= members.size() || members[sleep->slot] != entity) return npos;
+        return sleep->slot;
+    }
+
+    uint32_t find(uint32_t slot) {
+        while (parent[slot] != slot) {
+            parent[slot] = parent[parent[slot]];
+            slot = parent[slot];
+        }
+        return slot;
+    }
+
+    void unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (b < a) std::swap(a, b);
+        parent[b] = a;
+    }
+
+    static bool awakeMovable(const ComponentBitMask& mask) {
+        return maskHas<MovableComponent>(mask) && !maskHas<SleepingComponent>(mask);
+    }
+
+public:
+    void operator()(ECS& ecs, const float& deltaTime, RenderingQueues&) {
+        const auto& entities = ecs.getEntitiesWithComponent<SleepStateComponent>()
+                                   .andHas<PositionComponent>()
+                                   .andHas<MovableComponent>()
+                                   .get();
+
+        members.clear();
+        for (auto entity : entities) {
+            auto& sleep = *ecs.getComponent<SleepStateComponent>(entity);
+            sleep.slot = static_cast<uint32_t>(members.size());
+            members.push_back(entity);
+
+            float step;
+            if (!simLodDue(ecs, entity, deltaTime, step)) continue;
+
+            const auto& position = *ecs.getComponent<PositionComponent>(entity);
+            const auto& movable = *ecs.getComponent<MovableComponent>(entity);
+
+            if (ecs.entityStorage.hasComponent<SleepingComponent>(entity)) {
+                const float ddx = movable.dx - sleep.dx;
+                const float ddy = movable.dy - sleep.dy;
+                if (ddx * ddx + ddy * ddy > sleep_wake_velocity_change * sleep_wake_velocity_change) {
+                    sleep.stillTicks = 0;
+                }
+            } else {
+                const float mx = position.x - sleep.x;
+                const float my = position.y - sleep.y;
+                const float limit = sleep_speed_threshold * step;
+                const bool still = mx * mx + my * my < limit * limit;
+                sleep.stillTicks = still ? std::min<uint16_t>(sleep.stillTicks + 1, sleep_ticks) : 0;
+            }
+            sleep.x = position.x;
+            sleep.y = position.y;
+        }
+
+        parent.resize(members.size());
+        for (uint32_t slot = 0; slot < members.size(); ++slot) parent[slot] = slot;
+
+        for (const auto& contact : ecs.contacts.getAll()) {
+            auto* sleepA = ecs.getComponent<SleepStateComponent>(contact.a);
+            auto* sleepB = ecs.getComponent<SleepStateComponent>(contact.b);
+            const uint32_t slotA = slotOf(contact.a, sleepA);
+            const uint32_t slotB = slotOf(contact.b, sleepB);
+            if (slotA != npos && slotB != npos) {
+                unite(slotA, slotB);
+            } else if (slotA != npos) {
+                if (awakeMovable(ecs.entityStorage.getComponentMask(contact.b))) sleepA->stillTicks = 0;
+            } else if (slotB != npos) {
+                if (awakeMovable(ecs.entityStorage.getComponentMask(contact.a))) sleepB->stillTicks = 0;
+            }
+        }
+
+        // An island sleeps only if every member is ready to.
+        islandStill.assign(members.size(), 1);
+        for (uint32_t slot = 0; slot < members.size(); ++slot) {
+            if (ecs.getComponent<SleepStateComponent>(members[slot])->stillTicks < sleep_ticks) {
+                islandStill[find(slot)] = 0;
+            }
+        }
+
+        for (uint32_t slot = 0; slot < members.size(); ++slot) {
+            const EntityID entity = members[slot];
+            const bool still = islandStill[find(slot)];
+            const bool sleeping = ecs.entityStorage.hasComponent<SleepingComponent>(entity);
+            if (still && !sleeping) {
+                auto& sleep = *ecs.getComponent<SleepStateComponent>(entity);
+                const auto& movable = *ecs.getComponent<MovableComponent>(entity);
+                sleep.dx = movable.dx;
+                sleep.dy = movable.dy;
+                ecs.commands.addComponent(entity, SleepingComponent{});
+            } else if (!still && sleeping) {
+                ecs.commands.removeComponent<SleepingComponent>(entity);
+            }
+        }
+    }
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../ECS.hpp"
+#include "../Resources/InputState.hpp"
+#include "../Resources/PlayerState.hpp"
+
+// Spawns a pooled follower at (x, y). The prefab resets everything but the
+// position and the sleep state, which start at the spawn point.
+inline EntityID spawnFollower(ECS& ecs, PrefabID prefab, float x, float y) {
+    EntityID follower = ecs.spawn(prefab);
+    ecs.setComponent(follower, PositionComponent{x, y, 0.f});
+    ecs.setComponent(follower, PreviousPositionComponent{x, y, 0.f});
+    ecs.setComponent(follower, SleepStateComponent{x, y});
+    return follower;
+}
+
+// Fires a bullet from the player every tick Space is held, and tops the
+// world up to `maxActiveEntities` with one follower per tick next to the
+// player. Runs last in its stage, new entities simulate from the next tick.
+class SpawnSystem {
+private:
+    PrefabID bulletPrefab;
+    PrefabID followerPrefab;
+    size_t maxActiveEntities;
+
+public:
+    SpawnSystem(PrefabID bulletPrefab, PrefabID followerPrefab, size_t maxActiveEntities)
+        : bulletPrefab(bulletPrefab), followerPrefab(followerPrefab), maxActiveEntities(maxActiveEntities) {}
+
+    void operator()(ECS& ecs, const float&, RenderingQueues&) {
+        const auto* position = ecs.getComponent<PositionComponent>(ecs.resource<PlayerState>().entity);
+        if (position == nullptr) return;
+        const auto [x, y, z] = *position;
+
+        if (ecs.resource<InputState>().isPressed(Key::Space)) {
+            EntityID bullet = ecs.spawn(bulletPrefab);
+            ecs.setComponent(bullet, PositionComponent{x, y, z});
+            ecs.setComponent(bullet, PreviousPositionComponent{x, y, z});
+        }
+
+        if (ecs.entityStorage.getNumberOfActiveEntities() < maxActiveEntities) {
+            spawnFollower(ecs, followerPrefab, x - 5.f, y - 5.f);
+        }
+    }
+};
@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "../Resources/BroadphaseStats.hpp"
+#include "../Storage/EntityStorage.hpp"
+#include "CollisionProxies.hpp"
+
+// Sweep and prune over one axis. The sorted order is kept between passes and
+// repaired with an insertion sort, which is close to linear while entities
+// slide a little each tick. The sweep axis is the one the proxies spread
+// along the most; switching it costs a full sort, so it only switches once
+// the other axis is clearly wider.
+class SweepAndPrune {
+private:
+    // Variance ratio the other axis needs before the sweep axis changes.
+    static constexpr float axis_switch_ratio = 1.25f;
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    struct Entry {
+        float lo, hi;          // extent on the sweep axis
+        float otherLo, otherHi;
+        EntityID id;
+        uint32_t proxy;
+    };
+
+    std::vector<Entry> entries;  // sorted by lo
+    std::vector<uint32_t> rankOf;  // proxy index -> position in entries, npos when left out
+    std::unordered_map<EntityID, uint32_t> proxyOf;
+    std::vector<uint8_t> placed;  // proxies already in entries this pass
+    bool sweepX = true;
+    float maxExtent = 0.0f;       // largest hi - lo
+    BroadphaseStats statistics;
+
+    Entry entryFor(const CollisionProxies& proxies, uint32_t i) const {
+        const float along = sweepX ? proxies.x[i] : proxies.y[i];
+        const float across = sweepX ? proxies.y[i] : proxies.x[i];
+        const float r = proxies.r[i];
+        return {along - r, along + r, across - r, across + r, proxies.ids[i], i};
+    }
+
+    static bool finite(const CollisionProxies& proxies, size_t i) {
+        return std::isfinite(proxies.x[i]) && std::isfinite(proxies.y[i]) && std::isfinite(proxies.r[i]);
+    }
+
+    // Picks the sweep axis, returns true when it changed.
+    bool chooseAxis(const CollisionProxies& proxies) {
+        double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumYY = 0.0;
+        size_t count = 0;
+        for (size_t i = 0; i < proxies.size(); ++i) {
+            if (!finite(proxies, i)) continue;
+            sumX += proxies.x[i];
+            sumY += proxies.y[i];
+            sumXX += double(proxies.x[i]) * proxies.x[i];
+            sumYY += double(proxies.y[i]) * proxies.y[i];
+            ++count;
+        }
+        if (count < 2) return false;
+        const double varianceX = sumXX / count - (sumX / count) * (sumX / count);
+        const double varianceY = sumYY / count - (sumY / count) * (sumY / count);
+        const double current = sweepX ? varianceX : varianceY;
+        const double other = sweepX ? varianceY : varianceX;
+        if (other <= current * axis_switch_ratio) return false;
+        sweepX = !sweepX;
+        return true;
+    }
+
+    static bool byLo(const Entry& a, const Entry& b) { return a.lo < b.lo; }
+
+    // Insertion sort of the first `end` entries by lo, counting entries that
+    // had to move.
+    size_t repairOrder(size_t end) {
+        size_t moved = 0;
+        for (size_t i = 1; i < end; ++i) {
+            if (!(entries[i].lo < entries[i - 1].lo)) continue;
+            const Entry entry = entries[i];
+            size_t j = i;
+            do {
+                entries[j] = entries[j - 1];
+                --j;
+            } while (j > 0 && entry.lo < entries[j - 1].lo);
+            entries[j] = entry;
+            ++moved;
+        }
+        return moved;
+    }
+
+    static bool overlapsAcross(const Entry& a, const Entry& b) {
+        return a.otherLo <= b.otherHi && b.otherLo <= a.otherHi;
+    }
+
+public:
+    // Brings the sorted order up to date with this pass's proxies. Entities
+    // that were not gathered are dropped, new ones are sorted in.
+    void build(const CollisionProxies& proxies) {
+        const size_t count = proxies.size();
+        statistics.proxies = count;
+        statistics.nonFinite = 0;
+        statistics.minX = statistics.minY = std::numeric_limits<float>::max();
+        statistics.maxX = statistics.maxY = std::numeric_limits<float>::lowest();
+
+        proxyOf.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            if (!finite(proxies, i)) {
+                ++statistics.nonFinite;
+                continue;
+            }
+            proxyOf.emplace(proxies.ids[i], i);
+            statistics.minX = std::min(statistics.minX, proxies.x[i]);
+            statistics.minY = std::min(statistics.minY, proxies.y[i]);
+            statistics.maxX = std::max(statistics.maxX, proxies.x[i]);
+            statistics.maxY = std::max(statistics.maxY, proxies.y[i]);
+        }
+        if (proxyOf.empty()) {
+            statistics.minX = statistics.minY = statistics.maxX = statistics.maxY = 0.0f;
+        }
+        const bool axisChanged = chooseAxis(proxies);
+
+        // Refresh the entries still present in place, keeping their order.
+        placed.assign(count, 0);
+        size_t kept = 0;
+        for (const auto& entry : entries) {
+            const auto it = proxyOf.find(entry.id);
+            if (it == proxyOf.end()) continue;
+            entries[kept++] = entryFor(proxies, it->second);
+            placed[it->second] = 1;
+        }
+        entries.resize(kept);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (!placed[i] && finite(proxies, i)) entries.push_back(entryFor(proxies, i));
+        }
+
+        if (axisChanged) {
+            std::sort(entries.begin(), entries.end(), byLo);
+            statistics.relocated = entries.size();
+        } else {
+            // Newcomers are sorted on their own and merged in, insertion
+            // sort only repairs what was already in order last pass.
+            statistics.relocated = repairOrder(kept) + (entries.size() - kept);
+            std::sort(entries.begin() + kept, entries.end(), byLo);
+            std::inplace_merge(entries.begin(), entries.begin() + kept, entries.end(), byLo);
+        }
+
+        rankOf.assign(count, npos);
+        maxExtent = 0.0f;
+        for (uint32_t k = 0; k < entries.size(); ++k) {
+            rankOf[entries[k].proxy] = k;
+            maxExtent = std::max(maxExtent, entries[k].hi - entries[k].lo);
+        }
+    }
+
+    // Calls `visit` with every proxy whose bounding box overlaps the one of
+    // `index`, including `index` itself.
+    template<typename Visit>
+    void query(const CollisionProxies&, size_t index, Visit&& visit) const {
+        const uint32_t rank = rankOf[index];
+        if (rank == npos) return;
+        const Entry& self = entries[rank];
+        visit(self.proxy);
+        for (size_t k = rank + 1; k < entries.size() && entries[k].lo <= self.hi; ++k) {
+            if (overlapsAcross(self, entries[k])) visit(entries[k].proxy);
+        }
+        // Earlier entries start before us and are at most maxExtent long.
+        for (size_t k = rank; k-- > 0 && entries[k].lo >= self.lo - maxExtent;) {
+            if (entries[k].hi >= self.lo && overlapsAcross(self, entries[k])) visit(entries[k].proxy);
+        }
+    }
+
+    // Sweeps the sorted order once and calls `visit(i, j)` for every pair of
+    // proxies whose bounding boxes overlap, each pair once, as it is found.
+    template<typename Visit>
+    void forEachPair(Visit&& visit) const {
+        for (size_t a = 0; a < entries.size(); ++a) {
+            for (size_t b = a + 1; b < entries.size() && entries[b].lo <= entries[a].hi; ++b) {
+                if (overlapsAcross(entries[a], entries[b])) visit(entries[a].proxy, entries[b].proxy);
+            }
+        }
+    }
+
+    bool sweepsAlongX() const { return sweepX; }
+
+    const BroadphaseStats& stats() const { return statistics; }
+};
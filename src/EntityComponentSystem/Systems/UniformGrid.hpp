@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "CollisionProxies.hpp"
+
+// Broadphase over a uniform grid covering the proxies' bounds. Cells are at
+// least twice the largest radius, so every overlap of a proxy lies in the 3x3
+// block around its cell. Proxies with a non-finite position or radius are
+// left out, as LooseQuadTree::build does. The grid is rebuilt each pass by a
+// counting sort into flat arrays that keep their capacity between passes.
+class UniformGrid {
+private:
+    // Caps the cell count for sparse worlds, cells grow instead.
+    static constexpr size_t min_cell_budget = 1024;
+
+    float originX = 0.0f;
+    float originY = 0.0f;
+    float inverseCellSize = 1.0f;
+    int32_t columns = 1;
+    int32_t rows = 1;
+
+    std::vector<uint32_t> cellOf;     // cell of each proxy
+    std::vector<uint32_t> cellStart;  // prefix sums, proxies of cell c are [cellStart[c], cellStart[c + 1])
+    std::vector<uint32_t> sorted;     // proxy indices ordered by cell
+
+    // Cell past the grid that holds the non-finite proxies, no query reads it.
+    uint32_t skippedCell() const { return static_cast<uint32_t>(columns) * static_cast<uint32_t>(rows); }
+
+    static bool finite(const CollisionProxies& proxies, size_t i) {
+        return std::isfinite(proxies.x[i]) && std::isfinite(proxies.y[i]) && std::isfinite(proxies.r[i]);
+    }
+
+    // Clamped in float before the cast, which is undefined out of range.
+    static int32_t cellIndex(float offset, float inverseCellSize, int32_t cells) {
+        return static_cast<int32_t>(std::clamp(offset * inverseCellSize, 0.0f, static_cast<float>(cells - 1)));
+    }
+
+public:
+    void build(const CollisionProxies& proxies) {
+        const size_t count = proxies.size();
+
+        // Bounds and radius in double, so a world spanning the float range
+        // does not overflow its own extent.
+        double minX = 0.0, maxX = 0.0, minY = 0.0, maxY = 0.0;
+        float maxRadius = 0.0f;
+        bool any = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (!finite(proxies, i)) continue;
+            const double x = proxies.x[i];
+            const double y = proxies.y[i];
+            minX = any ? std::min(minX, x) : x;
+            maxX = any ? std::max(maxX, x) : x;
+            minY = any ? std::min(minY, y) : y;
+            maxY = any ? std::max(maxY, y) : y;
+            maxRadius = std::max(maxRadius, proxies.r[i]);
+            any = true;
+        }
+        const double width = maxX - minX;
+        const double height = maxY - minY;
+
+        // The budget bounds columns * rows, however far apart the proxies are.
+        double cellSize = std::max(2.0 * maxRadius, 1e-3);
+        const double cellBudget = static_cast<double>(std::max(min_cell_budget, 2 * count));
+        cellSize = std::max(cellSize, std::sqrt(width * height / cellBudget));
+        while ((width / cellSize + 1.0) * (height / cellSize + 1.0) > cellBudget) {
+            cellSize *= 1.5;
+        }
+
+        originX = static_cast<float>(minX);
+        originY = static_cast<float>(minY);
+        inverseCellSize = static_cast<float>(1.0 / cellSize);
+        columns = static_cast<int32_t>(width / cellSize) + 1;
+        rows = static_cast<int32_t>(height / cellSize) + 1;
+        const size_t cells = skippedCell();
+
+        // Pass one counts proxies per cell, pass two places them.
+        cellOf.resize(count);
+        cellStart.assign(cells + 2, 0);
+        for (size_t i = 0; i < count; ++i) {
+            cellOf[i] = finite(proxies, i)
+                ? static_cast<uint32_t>(cellIndex(proxies.y[i] - originY, inverseCellSize, rows) * columns +
+                                        cellIndex(proxies.x[i] - originX, inverseCellSize, columns))
+                : static_cast<uint32_t>(cells);
+            ++cellStart[cellOf[i] + 1];
+        }
+        for (size_t c = 0; c <= cells; ++c) {
+            cellStart[c + 1] += cellStart[c];
+        }
+        sorted.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            sorted[cellStart[cellOf[i]]++] = static_cast<uint32_t>(i);
+        }
+        // Placing advanced every start to the next cell's, shift them back.
+        for (size_t c = cells + 1; c > 0; --c) {
+            cellStart[c] = cellStart[c - 1];
+        }
+        cellStart[0] = 0;
+    }
+
+    // Calls `visit` with every proxy in the 3x3 block around `index`,
+    // including `index` itself. Non-finite proxies visit nothing.
+    template<typename Visit>
+    void query(const CollisionProxies&, size_t index, Visit&& visit) const {
+        if (cellOf[index] == skippedCell()) return;
+        const int32_t cx = static_cast<int32_t>(cellOf[index] % static_cast<uint32_t>(columns));
+        const int32_t cy = static_cast<int32_t>(cellOf[index] / static_cast<uint32_t>(columns));
+        for (int32_t y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows - 1); ++y) {
+            const size_t first = static_cast<size_t>(y * columns + std::max(cx - 1, 0));
+            const size_t last = static_cast<size_t>(y * columns + std::min(cx + 1, columns - 1));
+            // Cells of one row are adjacent, so the block row is one range.
+            for (uint32_t k = cellStart[first]; k < cellStart[last + 1]; ++k) {
+                visit(sorted[k]);
+            }
+        }
+    }
+};
@@ -6,6 +6,8 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include "../EntityComponentSystem/Resources/BroadphaseStats.hpp"
+#include "../EntityComponentSystem/Storage/MemoryStats.hpp"
 #include "../InputHandler/InputHandler.hpp"
 
 inline void setupImGui(GLFWwindow* window) {
@@ -17,7 +19,32 @@ inline void setupImGui(GLFWwindow* window) {
     ImGui_ImplOpenGL3_Init("#version 460");
 };
 
-inline void updateImGui(GLFWwindow* window, size_t numOfEntities, float deltaTime) {
+inline void memoryTable(const char* id, const std::vector<MemoryStats>& entries) {
+    if (!ImGui::BeginTable(id, 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+    ImGui::TableSetupColumn("Name");
+    ImGui::TableSetupColumn("Live KiB");
+    ImGui::TableSetupColumn("Capacity KiB");
+    ImGui::TableSetupColumn("Peak KiB");
+    ImGui::TableSetupColumn("Frag");
+    ImGui::TableHeadersRow();
+    for (const auto& stats : entries) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(stats.name.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", stats.liveBytes / 1024.0f);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", stats.capacityBytes / 1024.0f);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", stats.highWaterBytes / 1024.0f);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.0f%%", stats.fragmentation * 100.0f);
+    }
+    ImGui::EndTable();
+}
+
+inline void updateImGui(GLFWwindow* window, size_t numOfEntities, const MemoryReport& memory,
+                        const BroadphaseStats& broadphase, float deltaTime) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -33,6 +60,26 @@ inline void updateImGui(GLFWwindow* window, size_t numOfEntities, float deltaTim
 
     ImGui::Text("FPS: %.1f", smoothedFPS);
 
+    if (ImGui::CollapsingHeader("Memory")) {
+        ImGui::Text("Live: %.1f KiB  Capacity: %.1f KiB  Peak: %.1f KiB",
+                    memory.liveBytes / 1024.0f, memory.capacityBytes / 1024.0f,
+                    memory.highWaterBytes / 1024.0f);
+        memoryTable("storages", memory.storages);
+        if (ImGui::TreeNode("Queries", "Queries (%zu)", memory.queries.size())) {
+            memoryTable("queries", memory.queries);
+            ImGui::TreePop();
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Broadphase")) {
+        ImGui::Text("Bounds: (%.1f, %.1f) - (%.1f, %.1f)", broadphase.minX, broadphase.minY,
+                    broadphase.maxX, broadphase.maxY);
+        ImGui::Text("Root half size: %.1f  Growths: %llu", broadphase.rootHalfSize,
+                    static_cast<unsigned long long>(broadphase.rootGrowths));
+        ImGui::Text("Proxies: %zu  Relocated: %zu  Non-finite: %zu", broadphase.proxies,
+                    broadphase.relocated, broadphase.nonFinite);
+    }
+
     // Debug input states
     if (gInputHandler.isClicked(Key::W)) ImGui::Text("W clicked");
     if (gInputHandler.isPressed(Key::W)) ImGui::Text("W pressed");
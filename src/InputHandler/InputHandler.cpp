@@ -2,8 +2,8 @@
 
 InputHandler gInputHandler;
 
-void keyCallback(GLFWwindow* window, const int key, int scancode,
-                 const int action, int mods) {
+void keyCallback(GLFWwindow*, const int key, int,
+                 const int action, int) {
     switch (key) {
         case GLFW_KEY_W:      (action == GLFW_PRESS) ? gInputHandler.pressKey(Key::W) : gInputHandler.releaseKey(Key::W); break;
         case GLFW_KEY_A:      (action == GLFW_PRESS) ? gInputHandler.pressKey(Key::A) : gInputHandler.releaseKey(Key::A); break;
@@ -22,33 +22,37 @@ void keyCallback(GLFWwindow* window, const int key, int scancode,
 
 void InputHandler::pressKey(Key key) {
     if (const auto idx = static_cast<size_t>(key);
-        keyStates[idx] == KeyState::Released)
-        keyStates[idx] = KeyState::Clicked;
-    else
-        keyStates[idx] = KeyState::Pressed;
+        keyStates[idx].load() == KeyState::Released) {
+        keyStates[idx].store(KeyState::Clicked);
+        presses[idx].fetch_add(1, std::memory_order_release);
+    } else
+        keyStates[idx].store(KeyState::Pressed);
 }
 
 void InputHandler::releaseKey(Key key) {
-    keyStates[static_cast<size_t>(key)] = KeyState::Released;
+    keyStates[static_cast<size_t>(key)].store(KeyState::Released);
 }
 
 void InputHandler::update() {
     for (auto &state : keyStates) {
-        if (state == KeyState::Clicked) {
-            state = KeyState::Pressed;
-        }
+        auto clicked = KeyState::Clicked;
+        state.compare_exchange_strong(clicked, KeyState::Pressed);
     }
 }
 
+uint32_t InputHandler::pressCount(Key key) const {
+    return presses[static_cast<size_t>(key)].load(std::memory_order_acquire);
+}
+
 bool InputHandler::isPressed(Key key) const {
-    const KeyState state = keyStates[static_cast<size_t>(key)];
+    const KeyState state = keyStates[static_cast<size_t>(key)].load();
     return state == KeyState::Pressed || state == KeyState::Clicked;
 }
 
 bool InputHandler::isClicked(Key key) const {
-    return keyStates[static_cast<size_t>(key)] == KeyState::Clicked;
+    return keyStates[static_cast<size_t>(key)].load() == KeyState::Clicked;
 }
 
 bool InputHandler::isReleased(Key key) const {
-    return keyStates[static_cast<size_t>(key)] == KeyState::Released;
+    return keyStates[static_cast<size_t>(key)].load() == KeyState::Released;
 }
\ No newline at end of file
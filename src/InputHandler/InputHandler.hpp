@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <GLFW/glfw3.h>
 
 enum class Key {
@@ -25,14 +27,22 @@ enum class KeyState {
     Clicked
 };
 
+// Written by GLFW callbacks on the main thread. The key states and their
+// Clicked -> Pressed step in update() belong to the main thread; the
+// simulation thread samples pressCount() into its InputState instead, so it
+// sees every press no matter how ticks and frames interleave.
 class InputHandler {
-    std::array<KeyState, static_cast<size_t>(Key::COUNT)> keyStates{};
+    std::array<std::atomic<KeyState>, static_cast<size_t>(Key::COUNT)> keyStates{};
+    std::array<std::atomic<uint32_t>, static_cast<size_t>(Key::COUNT)> presses{};
 
 public:
     void pressKey(Key key);
     void releaseKey(Key key);
     void update();
 
+    // Number of times `key` went down since startup.
+    uint32_t pressCount(Key key) const;
+
     bool isPressed(Key key) const;
     bool isClicked(Key key) const;
     bool isReleased(Key key) const;
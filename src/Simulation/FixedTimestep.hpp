@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Turns variable frame times into a whole number of fixed simulation ticks.
+// Whatever is left in the accumulator is exposed as the blend factor between
+// the last two simulated states.
+class FixedTimestep {
+    float step;
+    int maxStepsPerFrame;
+    float accumulator = 0.0f;
+
+    // Frames longer than this (breakpoints, window drags) are not caught up.
+    static constexpr float max_frame_time = 0.25f;
+
+public:
+    explicit FixedTimestep(float tickRate, int maxStepsPerFrame = 5)
+        : step(1.0f / tickRate), maxStepsPerFrame(maxStepsPerFrame) {}
+
+    void setTickRate(float tickRate) { step = 1.0f / tickRate; }
+    float getStep() const { return step; }
+
+    // Returns how many ticks to simulate for a frame that took `frameTime`.
+    int advance(float frameTime) {
+        accumulator += std::min(frameTime, max_frame_time);
+        int steps = 0;
+        while (accumulator >= step && steps < maxStepsPerFrame) {
+            accumulator -= step;
+            ++steps;
+        }
+        // Out of catch-up budget: drop the backlog instead of spiralling.
+        if (accumulator >= step) {
+            accumulator = std::fmod(accumulator, step);
+        }
+        return steps;
+    }
+
+    float alpha() const { return accumulator / step; }
+};
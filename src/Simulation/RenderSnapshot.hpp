@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+
+#include "../EntityComponentSystem/ECS.hpp"
+#include "../EntityComponentSystem/Resources/BroadphaseStats.hpp"
+
+// Everything the GL thread needs to draw one frame, produced by the
+// simulation thread and handed over through a SnapshotMailbox.
+struct RenderSnapshot {
+    RenderingQueues queues{
+        std::make_shared<DrawQueue<UnlitVertex, UnlitMaterial>>(),
+        std::make_shared<DrawQueue<ColoredVertex, EmptyMaterial>>()};
+    glm::vec3 playerPosition{0.0f};
+    size_t numOfEntities = 0;
+    MemoryReport memory;  // refreshed every few ticks, see ECS::memoryReport()
+    BroadphaseStats broadphase;
+
+    void clear() {
+        queues.unlitQueue->clear();
+        queues.coloredQueue->clear();
+    }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer between one writer and one reader. The writer
+// fills writeBuffer() and publishes it, the reader picks up the newest
+// published slot with acquire(). Neither side ever waits on the other and a
+// slot is never visible to both at once.
+template <typename T>
+class SnapshotMailbox {
+    static constexpr std::uint8_t index_mask = 0b011;
+    static constexpr std::uint8_t fresh_bit = 0b100;
+
+    std::array<T, 3> slots{};
+    std::atomic<std::uint8_t> middle{1};
+    std::uint8_t back = 0;   // owned by the writer
+    std::uint8_t front = 2;  // owned by the reader
+
+public:
+    T& writeBuffer() { return slots[back]; }
+
+    void publish() {
+        back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // True once the reader has taken the last published slot.
+    bool isConsumed() const {
+        return (middle.load(std::memory_order_acquire) & fresh_bit) == 0;
+    }
+
+    // Swaps in the newest published slot. Returns false when nothing new was
+    // published, readBuffer() then still holds the previous snapshot.
+    bool acquire() {
+        if (isConsumed()) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    const T& readBuffer() const { return slots[front]; }
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops inside systems.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+
+    void push(std::function<void()> task);
+    // Runs one queued task on the calling thread, returns false if none was queued.
+    bool runOne();
+
+public:
+    explicit ThreadPool(size_t workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1);
+    ~ThreadPool();
+
+    // Threads taking part in parallelFor(), the caller included.
+    size_t concurrency() const { return workers.size() + 1; }
+
+    // Runs fn(task) for every task in [0, taskCount) and returns when all are
+    // done. The caller runs tasks too, also those of other callers while it
+    // waits, so nested and concurrent calls cannot deadlock.
+    template<typename F>
+    void parallelFor(size_t taskCount, F&& fn) {
+        if (taskCount == 0) return;
+        if (taskCount == 1 || workers.empty()) {
+            for (size_t task = 0; task < taskCount; ++task) fn(task);
+            return;
+        }
+        std::atomic<size_t> remaining{taskCount - 1};
+        for (size_t task = 1; task < taskCount; ++task) {
+            push([&fn, &remaining, task] {
+                fn(task);
+                remaining.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        fn(0);
+        while (remaining.load(std::memory_order_acquire) != 0) {
+            if (!runOne()) std::this_thread::yield();
+        }
+    }
+};
+
+extern ThreadPool gThreadPool;
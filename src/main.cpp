@@ -5,20 +5,35 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
 
 #include "EntityComponentSystem/Components/MovableComponent.hpp"
 #include "EntityComponentSystem/Components/RenderableComponent.hpp"
 #include "EntityComponentSystem/ECS.hpp"
+#include "EntityComponentSystem/Resources/InputState.hpp"
 #include "EntityComponentSystem/Systems/CollidingSystem.hpp"
 #include "EntityComponentSystem/Systems/CollisionResolutionSystem.hpp"
 #include "EntityComponentSystem/Systems/FollowingPlayerSystem.hpp"
 #include "EntityComponentSystem/Systems/MovementSystem.hpp"
+#include "EntityComponentSystem/Systems/MortonReorderSystem.hpp"
+#include "EntityComponentSystem/Systems/ParallelCollidingSystem.hpp"
 #include "EntityComponentSystem/Systems/PlayerMovementSystem.hpp"
+#include "EntityComponentSystem/Systems/PlayerStateSystem.hpp"
+#include "EntityComponentSystem/Systems/PreviousPositionSystem.hpp"
 #include "EntityComponentSystem/Systems/RemoveEntitySystem.hpp"
+#include "EntityComponentSystem/Systems/SimLodSystem.hpp"
+#include "EntityComponentSystem/Systems/SleepSystem.hpp"
+#include "EntityComponentSystem/Systems/SpawnSystem.hpp"
+#include "EntityComponentSystem/Systems/SweepAndPrune.hpp"
 #include "EntityComponentSystem/Systems/RenderingSystem.hpp"
 #include "EntityComponentSystem/Systems/BulletSystem.hpp"
+#include "Simulation/FixedTimestep.hpp"
+#include "Simulation/RenderSnapshot.hpp"
+#include "Simulation/SnapshotMailbox.hpp"
 #include "ImGui/ImGui.hpp"
 #include "InputHandler/InputHandler.hpp"
 #include "MusicManager/MusicManager.hpp"
@@ -29,14 +44,29 @@
 #include "shader.h"
 #include "std140.h"
 
-void debugSystem(ECS& ecs, const float& deltaTime,
-                 RenderingQueues& renderingQueues) {
-    auto& movables = ecs.getEntitiesWithComponent<MovableComponent>().get();
+void debugSystem(ECS& ecs, const float&,
+                 RenderingQueues&) {
+    [[maybe_unused]] auto& movables = ecs.getEntitiesWithComponent<MovableComponent>().get();
     // std::cout << "Debug: " << movables.size() << " movables tracked.\n";
 }
 
 constexpr float SCREEN_WIDTH = 1280;
 constexpr float SCREEN_HEIGHT = 720;
+constexpr float SIMULATION_TICK_RATE = 60.0f;
+constexpr int MAX_SIMULATION_STEPS_PER_FRAME = 5;
+constexpr float BULLET_RANGE = 20.0f;
+constexpr float BULLET_SPEED = 20.0f;
+// Bullets fly at their capped speed for most of their range.
+constexpr uint64_t BULLET_LIFETIME_TICKS = static_cast<uint64_t>(BULLET_RANGE / BULLET_SPEED * SIMULATION_TICK_RATE);
+constexpr float FOLLOWER_STEERING_BUDGET = 0.0005f;
+constexpr float SIM_LOD_REFRESH_BUDGET = 0.0002f;
+constexpr int MEMORY_REPORT_INTERVAL_TICKS = 60;
+constexpr size_t MEMORY_BUDGET_BYTES = 64 * 1024 * 1024;
+constexpr size_t MAX_ACTIVE_ENTITIES = 500;
+// UniformGrid, LinearQuadTree, LooseQuadTree and SweepAndPrune are interchangeable.
+using Broadphase = LooseQuadTree;
+// Detects and separates contacts on the thread pool instead of in one pass each.
+constexpr bool PARALLEL_COLLISIONS = true;
 
 int main() {
     if (!glfwInit()) return -1;
@@ -211,27 +241,50 @@ int main() {
     float deltaTime = 0.0f;
     float lastFrame = 0.0f;
 
-    ECS ecs(RenderingQueues{std::move(dynamicUnlitQueue),
-                            std::move(dynamicColoredQueue)});
+    // Owned by the simulation thread once it starts, the GL thread only sees
+    // the snapshots it publishes. Update systems get these empty queues and
+    // must not draw; only render systems queue draws, into the snapshot.
+    ECS ecs(RenderingQueues{});
 
     EntityID player = ecs.createEntity();
+    ecs.resource<PlayerState>().entity = player;
 
     ecs.addComponent(player, PositionComponent{0.f, 0.f, 0.f});
+    ecs.addComponent(player, PreviousPositionComponent{0.f, 0.f, 0.f});
     ecs.addComponent(player, MovableComponent(14.f, 5.f));
     ecs.addComponent(player, HitBoxComponent(0.5f));
     ecs.addComponent(player, CollidingComponent{});
+    ecs.addComponent(player, CollisionLayerComponent{CollisionLayer::Player});
     ecs.addComponent(player, PlayerMovementComponent{});
-    ecs.addComponent(player, RenderableComponent{cubeUnlitPartial_1});
+    ecs.addSharedComponent(player, RenderableComponent{cubeUnlitPartial_1});
+
+    // Followers and bullets are recycled through pools, build() resets
+    // everything but the spawn position.
+    const PrefabID followerPrefab = ecs.registerPrefab([cubeUnlitPartial_1](ECS& ecs, EntityID entity) {
+        ecs.setComponent(entity, MovableComponent{5.f, 2.f});
+        ecs.setComponent(entity, HitBoxComponent(0.5f));
+        ecs.setComponent(entity, CollidingComponent{});
+        ecs.setComponent(entity, CollisionLayerComponent{CollisionLayer::Follower});
+        ecs.setComponent(entity, FollowPlayerComponent{});
+        ecs.setComponent(entity, SimLodComponent{});
+        ecs.removeComponent<SleepingComponent>(entity);
+        ecs.setSharedComponent(entity, RenderableComponent{cubeUnlitPartial_1});
+    });
+    const PrefabID bulletPrefab = ecs.registerPrefab([barrelPartial](ECS& ecs, EntityID entity) {
+        ecs.setComponent(entity, BulletComponent{270.f});
+        ecs.setComponent(entity, MovableComponent(BULLET_SPEED, 50));
+        ecs.setComponent(entity, HitBoxComponent{0.5});
+        ecs.setComponent(entity, CollidingComponent{});
+        ecs.setComponent(entity, ContinuousCollisionComponent{});
+        ecs.setComponent(entity, CollisionLayerComponent{CollisionLayer::Bullet});
+        ecs.setSharedComponent(entity, RenderableComponent{barrelPartial, glm::vec3(2.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)});
+        ecs.getComponent<PooledComponent>(entity)->timer =
+            ecs.timers.schedule(entity, BULLET_LIFETIME_TICKS, expireEntityAction);
+    });
 
     for (size_t i = 0; i < 50; ++i) {
         for (size_t j = 0; j < 10; ++j) {
-            EntityID followingPlayer = ecs.createEntity();
-            ecs.addComponent(followingPlayer, PositionComponent{5.f + (0.1f * i), 5.f + (0.1f * j), 0.f});
-            ecs.addComponent(followingPlayer, MovableComponent{5.f, 2.f});
-            ecs.addComponent(followingPlayer, HitBoxComponent(0.5f));
-            ecs.addComponent(followingPlayer, CollidingComponent{});
-            ecs.addComponent(followingPlayer, FollowPlayerComponent{});
-            ecs.addComponent(followingPlayer, RenderableComponent{cubeUnlitPartial_1});
+            spawnFollower(ecs, followerPrefab, 5.f + (0.1f * i), 5.f + (0.1f * j));
         }
     }
 
@@ -239,8 +292,9 @@ int main() {
     EntityID coin = ecs.createEntity();
     ecs.addComponent(coin, PositionComponent{0.f, 10.f, -0.5f});
     ecs.addComponent(coin, HitBoxComponent{0.3f});
-    ecs.addComponent(coin, RenderableComponent{barrelPartial, glm::vec3(2.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)});
+    ecs.addSharedComponent(coin, RenderableComponent{barrelPartial, glm::vec3(2.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)});
     ecs.addComponent(coin, CoinComponent{6});
+    ecs.addComponent(coin, CollisionLayerComponent{CollisionLayer::Coin});
 
     constexpr size_t N = 10;
     for (int q = -static_cast<int>(N); q <= static_cast<int>(N); q++) {
@@ -266,7 +320,8 @@ int main() {
             if (isOuter) {
                 ecs.addComponent(floor, HitBoxComponent{2.5f});
                 ecs.addComponent(floor, CollidingComponent{});
-                ecs.addComponent(floor, RenderableComponent{
+                ecs.addComponent(floor, CollisionLayerComponent{CollisionLayer::Static});
+                ecs.addSharedComponent(floor, RenderableComponent{
                     mountainPartial,
                     glm::vec3(2.0f),
                     glm::radians(90.0f),
@@ -279,7 +334,7 @@ int main() {
                     -y,
                     -0.5f
                 });
-                ecs.addComponent(floorUnder, RenderableComponent{
+                ecs.addSharedComponent(floorUnder, RenderableComponent{
                     hexGrassPartial,
                     glm::vec3(2.0f),
                     glm::radians(90.0f),
@@ -287,7 +342,7 @@ int main() {
                 });
             }
             else {
-                ecs.addComponent(floor, RenderableComponent{
+                ecs.addSharedComponent(floor, RenderableComponent{
                     hexGrassPartial,
                     glm::vec3(2.0f),
                     glm::radians(90.0f),
@@ -297,57 +352,105 @@ int main() {
         }
     }
 
+    ecs.onAdd<RemoveComponent>(removeEntityObserver);
+
     ecs.nextStage(ECS::StageType::Sequential)
-        .addSystem(playerMovementSystem)
-        .addSystem(followingPlayerSystem)
+        .addSystem(previousPositionSystem)
+        .addSystem(playerStateSystem).writes<PlayerState>()
+        .addSystem(simLodTierSystem).reads<PlayerState>().withBudget(SIM_LOD_REFRESH_BUDGET)
+        .addSystem(simLodScheduleSystem)
+        .addSystem(playerMovementSystem).reads<InputState>()
+        .addSystem(followingPlayerSystem).reads<PlayerState>().withBudget(FOLLOWER_STEERING_BUDGET)
         .addSystem(bulletSystem)
-        .addSystem(movementSystem)
-        .addSystem(collidingSystem)
-        .addSystem(collisionResolutionSystem)
-        .addSystem(debugSystem)
-        .addSystem(removeEntitySystem)
-        .addSystem(renderingSystem);
+        .addSystem(movementSystem);
+    if constexpr (PARALLEL_COLLISIONS) {
+        ecs.addSystem(ParallelCollidingSystem<Broadphase>{}).writes<BroadphaseStats>()
+            .addSystem(contactRulesSystem);
+    } else {
+        ecs.addSystem(CollidingSystem<Broadphase>{}).writes<BroadphaseStats>()
+            .addSystem(collisionResolutionSystem);
+    }
+    ecs.addSystem(SleepSystem{})
+        .addSystem(debugSystem).atRate(1.0f)
+        .addSystem(SpawnSystem{bulletPrefab, followerPrefab, MAX_ACTIVE_ENTITIES}).reads<InputState>().reads<PlayerState>();
+
+    ecs.nextStage(ECS::StageType::Sequential)
+        .addSystem(MortonReorderSystem<SimLodComponent, SleepStateComponent>{});
+
+    ecs.addRenderSystem(renderingSystem);
+    ecs.setMemoryBudget("total", MEMORY_BUDGET_BYTES);
+
+    SnapshotMailbox<RenderSnapshot> snapshots;
+    std::atomic<bool> simulationRunning{true};
+
+    std::thread simulation([&] {
+        FixedTimestep timestep(SIMULATION_TICK_RATE, MAX_SIMULATION_STEPS_PER_FRAME);
+        float lastTick = static_cast<float>(glfwGetTime());
+        MemoryReport memory;
+        int ticksSinceMemoryReport = MEMORY_REPORT_INTERVAL_TICKS;
+
+        while (simulationRunning.load(std::memory_order_relaxed)) {
+            float now = static_cast<float>(glfwGetTime());
+            const int steps = timestep.advance(now - lastTick);
+            lastTick = now;
+
+            for (int step = 0; step < steps; ++step) {
+                ecs.resource<InputState>().sample(gInputHandler);
+                ecs.update(timestep.getStep());
+                if (++ticksSinceMemoryReport >= MEMORY_REPORT_INTERVAL_TICKS) {
+                    memory = ecs.memoryReport();
+                    ticksSinceMemoryReport = 0;
+                }
+            }
+
+            // Without a new tick the only reason to publish is a fresh
+            // interpolation factor, and that is wasted until the GL thread
+            // has taken the previous snapshot.
+            if (steps == 0 && !snapshots.isConsumed()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+
+            const float alpha = timestep.alpha();
+            auto& snapshot = snapshots.writeBuffer();
+            snapshot.clear();
+            ecs.render(alpha, snapshot.queues);
+
+            auto position = ecs.getComponent<PositionComponent>(player);
+            auto previous = ecs.getComponent<PreviousPositionComponent>(player);
+            snapshot.playerPosition = glm::mix(glm::vec3(previous->x, previous->y, previous->z),
+                                               glm::vec3(position->x, position->y, position->z), alpha);
+            snapshot.numOfEntities = ecs.entityStorage.getNumberOfActiveEntities();
+            snapshot.memory = memory;
+            snapshot.broadphase = ecs.resource<BroadphaseStats>();
+            snapshots.publish();
+        }
+    });
 
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
-        ecs.update(deltaTime);
+        snapshots.acquire();
+        const auto& snapshot = snapshots.readBuffer();
+        // The dynamic stages clear their queues after drawing, copying keeps
+        // the snapshot intact in case no newer one arrives before next frame.
+        *dynamicUnlitQueue = *snapshot.queues.unlitQueue;
+        *dynamicColoredQueue = *snapshot.queues.coloredQueue;
 
-        updateImGui(window, ecs.entityStorage.getNumberOfEntities(), deltaTime);
+        updateImGui(window, snapshot.numOfEntities, snapshot.memory, snapshot.broadphase, deltaTime);
 
         if (gInputHandler.isPressed(Key::Num_1)) cameraOffset.z += 10 * deltaTime;
         if (gInputHandler.isPressed(Key::Num_2)) cameraOffset.z -= 10 * deltaTime;
 
-        auto position = ecs.getComponent<PositionComponent>(player);
-        auto [x, y, z] = *position;
-        if (gInputHandler.isPressed(Key::Space)) {
-            std::cout << "Space" << std::endl;
-            auto bullet = ecs.createEntity();
-            ecs.addComponent(bullet, PositionComponent{x, y, z});
-            ecs.addComponent(bullet, BulletComponent{270.f, 20.f});
-            ecs.addComponent(bullet, MovableComponent(20, 50));
-            ecs.addComponent(bullet, HitBoxComponent{0.5});
-            ecs.addComponent(bullet, CollidingComponent{});
-            ecs.addComponent(bullet, RenderableComponent{barrelPartial, glm::vec3(2.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)});
-        }
-
-        if (ecs.entityStorage.getNumberOfEntities() < 500) {
-            EntityID followingPlayer = ecs.createEntity();
-            ecs.addComponent(followingPlayer, PositionComponent{x - 5.f, y - 5.f, 0.f});
-            ecs.addComponent(followingPlayer, MovableComponent{5.f, 2.f});
-            ecs.addComponent(followingPlayer, HitBoxComponent(0.5f));
-            ecs.addComponent(followingPlayer, CollidingComponent{});
-            ecs.addComponent(followingPlayer, FollowPlayerComponent{});
-            ecs.addComponent(followingPlayer, RenderableComponent{cubeUnlitPartial_1});
-        }
+        glm::vec3 playerPosition = snapshot.playerPosition;
 
         gInputHandler.update();
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glm::vec3 targetCameraPos = glm::vec3(x, y, z) + cameraOffset;
+        glm::vec3 targetCameraPos = playerPosition + cameraOffset;
         cameraPos = glm::mix(cameraPos, targetCameraPos, 1.0f - expf(-smoothSpeed * deltaTime));
         glm::vec3 lookTarget = cameraPos - cameraOffset;
         cameraMatrices.view = glm::lookAt(cameraPos, lookTarget, worldUp);
@@ -359,6 +462,9 @@ int main() {
         glfwPollEvents();
     }
 
+    simulationRunning = false;
+    simulation.join();
+
     destroyImGui();
     destroyVertexArrays();
 
@@ -1,7 +1,32 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/MemoryLeakDetectorNewMacros.h"
 
 #include "../EntityComponentSystem/ECS.hpp"
+#include "../EntityComponentSystem/Resources/InputState.hpp"
+#include "../EntityComponentSystem/Resources/PlayerState.hpp"
+#include "../EntityComponentSystem/Systems/MortonReorderSystem.hpp"
+#include "../EntityComponentSystem/Systems/MovementSystem.hpp"
+#include "../EntityComponentSystem/Systems/SimLodSystem.hpp"
+#include "../EntityComponentSystem/Systems/SleepSystem.hpp"
+#include "../EntityComponentSystem/Systems/CollidingSystem.hpp"
+#include "../EntityComponentSystem/Systems/CollisionResolutionSystem.hpp"
+#include "../EntityComponentSystem/Systems/LooseQuadTree.hpp"
+#include "../EntityComponentSystem/Systems/ParallelCollidingSystem.hpp"
+#include "../EntityComponentSystem/Systems/QuadTree.hpp"
+#include "../EntityComponentSystem/Systems/SweepAndPrune.hpp"
+#include "../EntityComponentSystem/Systems/RemoveEntitySystem.hpp"
+#include "../EntityComponentSystem/Systems/RenderingSystem.hpp"
+#include "../Simulation/FixedTimestep.hpp"
+#include "../Simulation/SnapshotMailbox.hpp"
 
 TEST_GROUP(EntityComponentSystemGroup) {
     void setup() {
@@ -19,8 +44,8 @@ TEST(EntityComponentSystemGroup, SimpleTest) {
 
     for (size_t i = 0; i < numOfEntities; ++i) {
         auto entity = ecs.createEntity();
-        ecs.addComponent(entity, MovableComponent{});
-        ecs.addComponent(entity, MovableComponent{});
+        ecs.addComponent(entity, MovableComponent{0.f, 0.f});
+        ecs.addComponent(entity, MovableComponent{0.f, 0.f});
     }
 
     CHECK_EQUAL(numOfEntities, ecs.entityStorage.getAllEntities().size());
@@ -29,3 +54,1175 @@ TEST(EntityComponentSystemGroup, SimpleTest) {
     auto b = ecs.entityStorage.hasComponent<MovableComponent>(entity);
     CHECK_TRUE(b);
 }
+
+
+TEST(EntityComponentSystemGroup, ObserversAreBatchedUntilFlush) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+
+    std::vector<EntityID> added;
+    std::vector<EntityID> removed;
+    ecs.onAdd<CoinComponent>([&](ECS&, std::span<const EntityID> ids) {
+        added.insert(added.end(), ids.begin(), ids.end());
+    });
+    ecs.onRemove<CoinComponent>([&](ECS&, std::span<const EntityID> ids) {
+        removed.insert(removed.end(), ids.begin(), ids.end());
+    });
+
+    auto first = ecs.createEntity();
+    auto second = ecs.createEntity();
+    ecs.addComponent(first, CoinComponent{1});
+    ecs.addComponent(second, CoinComponent{2});
+    CHECK_EQUAL(0, added.size());
+
+    ecs.flush();
+    CHECK_EQUAL(2, added.size());
+
+    ecs.commands.removeEntity(first);
+    CHECK_EQUAL(0, removed.size());
+
+    ecs.flush();
+    CHECK_EQUAL(1, removed.size());
+    CHECK_EQUAL(first, removed.front());
+    CHECK_FALSE(ecs.entityStorage.hasEntity(first));
+}
+
+TEST(EntityComponentSystemGroup, QueryFiltersFollowComponentChanges) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+
+    auto coin = ecs.createEntity();
+    ecs.addComponent(coin, PositionComponent{});
+    ecs.addComponent(coin, CoinComponent{1});
+
+    auto bullet = ecs.createEntity();
+    ecs.addComponent(bullet, PositionComponent{});
+    ecs.addComponent(bullet, BulletComponent{0.f});
+
+    auto notCoins = ecs.getEntitiesWithComponent<PositionComponent>().without<CoinComponent>();
+    auto pickups = ecs.getEntitiesWithComponent<PositionComponent>().anyOf<CoinComponent, BulletComponent>();
+    auto withCoin = ecs.getEntitiesWithComponent<PositionComponent>().optional<CoinComponent>();
+
+    CHECK_EQUAL(1, notCoins.get().size());
+    CHECK_EQUAL(2, pickups.get().size());
+    CHECK_TRUE(maskHas<CoinComponent>(withCoin.getWithOptional().at(coin)));
+    CHECK_FALSE(maskHas<CoinComponent>(withCoin.getWithOptional().at(bullet)));
+
+    ecs.addComponent(bullet, CoinComponent{2});
+    CHECK_EQUAL(0, notCoins.get().size());
+    CHECK_TRUE(maskHas<CoinComponent>(withCoin.getWithOptional().at(bullet)));
+
+    ecs.removeComponent<CoinComponent>(coin);
+    CHECK_EQUAL(1, notCoins.get().size());
+    CHECK_EQUAL(1, notCoins.get().count(coin));
+}
+
+TEST(EntityComponentSystemGroup, PagedComponentsKeepTheirAddress) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+
+    auto first = ecs.createEntity();
+    ecs.addComponent(first, PositionComponent{1.f, 2.f, 3.f});
+    auto* position = ecs.getComponent<PositionComponent>(first);
+
+    for (size_t i = 0; i < 4096; ++i) {
+        auto entity = ecs.createEntity();
+        ecs.addComponent(entity, PositionComponent{static_cast<float>(i), 0.f, 0.f});
+    }
+
+    CHECK_TRUE(position == ecs.getComponent<PositionComponent>(first));
+    DOUBLES_EQUAL(2.f, position->y, 0.f);
+}
+
+TEST(EntityComponentSystemGroup, SharedComponentsAreStoredOncePerValue) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+
+    RenderableUnlit cube{DrawCommandPartial<UnlitVertex, UnlitMaterial>{Mesh{36, 0, 0}, 0}};
+    RenderableUnlit barrel{DrawCommandPartial<UnlitVertex, UnlitMaterial>{Mesh{96, 36, 24}, 1}};
+
+    for (size_t i = 0; i < 8; ++i) {
+        auto entity = ecs.createEntity();
+        ecs.addSharedComponent(entity, i < 6 ? cube : barrel);
+    }
+
+    const auto& groups = ecs.getSharedGroups<RenderableUnlit>();
+    CHECK_EQUAL(2, groups.size());
+    CHECK_EQUAL(6, groups[0].entities.size());
+    CHECK_EQUAL(2, groups[1].entities.size());
+    CHECK_TRUE(*ecs.getSharedComponent<RenderableUnlit>(7) == barrel);
+
+    ecs.removeEntity(0);
+    CHECK_EQUAL(5, groups[0].entities.size());
+
+    // Changing a value moves the entity between groups.
+    ecs.setSharedComponent(1, barrel);
+    CHECK_EQUAL(4, groups[0].entities.size());
+    CHECK_EQUAL(3, groups[1].entities.size());
+    CHECK_TRUE(groups[1].entities.contains(1));
+    CHECK_TRUE(*ecs.getSharedComponent<RenderableUnlit>(1) == barrel);
+
+    // Setting the handle directly does the same, handle 0 is the cube.
+    ecs.setComponent(7, SharedRenderableUnlit{0});
+    CHECK_TRUE(groups[0].entities.contains(7));
+    CHECK_FALSE(groups[1].entities.contains(7));
+    CHECK_EQUAL(2, groups.size());
+}
+
+TEST(EntityComponentSystemGroup, ResourcesAreSingletonsPerType) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+
+    auto& player = ecs.resource<PlayerState>();
+    player.entity = ecs.createEntity();
+    player.x = 4.f;
+
+    CHECK_TRUE(&player == &ecs.resource<PlayerState>());
+    DOUBLES_EQUAL(4.f, ecs.resource<PlayerState>().x, 0.f);
+    CHECK_EQUAL(1, ecs.entityStorage.getNumberOfEntities());
+}
+
+TEST(EntityComponentSystemGroup, InputStateLatchesPressesUntilSampled) {
+    InputHandler input;
+    InputState state;
+
+    // Tapped between two ticks, with the main thread's update() in between.
+    input.pressKey(Key::Space);
+    input.update();
+    input.releaseKey(Key::Space);
+    state.sample(input);
+    CHECK_TRUE(state.isClicked(Key::Space));
+    CHECK_TRUE(state.isPressed(Key::Space));
+    state.sample(input);
+    CHECK_FALSE(state.isClicked(Key::Space));
+    CHECK_FALSE(state.isPressed(Key::Space));
+
+    // Held across ticks, clicked on the first one only.
+    input.pressKey(Key::W);
+    state.sample(input);
+    CHECK_TRUE(state.isClicked(Key::W));
+    input.update();
+    state.sample(input);
+    CHECK_FALSE(state.isClicked(Key::W));
+    CHECK_TRUE(state.isPressed(Key::W));
+}
+
+TEST(EntityComponentSystemGroup, MemoryReportTracksHolesAndHighWater) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+
+    std::vector<EntityID> entities;
+    for (int i = 0; i < 4; ++i) {
+        entities.push_back(ecs.createEntity());
+        ecs.addComponent(entities.back(), CoinComponent{1});
+    }
+    ecs.removeEntity(entities[0]);
+    ecs.removeEntity(entities[1]);
+
+    auto find = [](const std::vector<MemoryStats>& entries, const std::string& name) {
+        for (const auto& stats : entries) {
+            if (stats.name == name) return stats;
+        }
+        return MemoryStats{};
+    };
+    auto report = ecs.memoryReport();
+    auto coins = find(report.storages, "CoinComponent");
+    CHECK_EQUAL(2 * (sizeof(CoinComponent) + sizeof(Cell)), coins.liveBytes);
+    DOUBLES_EQUAL(0.5f, coins.fragmentation, 0.0001f);
+    CHECK_TRUE(coins.highWaterBytes >= coins.capacityBytes);
+    CHECK_TRUE(report.capacityBytes >= report.liveBytes);
+}
+
+TEST(EntityComponentSystemGroup, MortonReorderKeepsComponentsWithTheirEntities) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    // Created far from Z-order: alternating between opposite corners.
+    std::vector<EntityID> entities;
+    std::vector<PositionComponent*> positions;
+    for (int i = 0; i < 16; ++i) {
+        const float x = (i % 2 == 0) ? static_cast<float>(i) : 100.f - i;
+        entities.push_back(ecs.createEntity());
+        ecs.addComponent(entities.back(), PositionComponent{x, x, static_cast<float>(i)});
+        ecs.addComponent(entities.back(), CoinComponent{static_cast<size_t>(i)});
+        positions.push_back(ecs.getComponent<PositionComponent>(entities.back()));
+    }
+
+    MortonReorderSystem<CoinComponent> reorder(4);
+    for (int tick = 0; tick < 8; ++tick) reorder(ecs, 0.f, queues);
+
+    for (int i = 0; i < 16; ++i) {
+        // Paged positions are only read, they keep their address.
+        POINTERS_EQUAL(positions[i], ecs.getComponent<PositionComponent>(entities[i]));
+        CHECK_EQUAL(static_cast<size_t>(i), ecs.getComponent<CoinComponent>(entities[i])->value);
+    }
+    // Positions lie on the diagonal, so Z-order equals order along x.
+    std::vector<std::pair<size_t, float>> bySlot;
+    for (auto entity : entities) {
+        bySlot.emplace_back(ecs.entityStorage.getComponentIndex<CoinComponent>(entity),
+                            ecs.getComponent<PositionComponent>(entity)->x);
+    }
+    std::sort(bySlot.begin(), bySlot.end());
+    float previousX = -1.f;
+    for (const auto& [slot, x] : bySlot) {
+        CHECK_TRUE(x > previousX);
+        previousX = x;
+    }
+}
+
+TEST(EntityComponentSystemGroup, MortonReorderLeavesNonFinitePositionsInPlace) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    const std::vector<std::pair<float, float>> spots{
+        {3.f, 3.f}, {nan, 0.f}, {-3e38f, -3e38f}, {0.f, inf}, {3e38f, 3e38f}, {-1e38f, -1e38f}};
+    std::vector<EntityID> entities;
+    for (size_t i = 0; i < spots.size(); ++i) {
+        entities.push_back(ecs.createEntity());
+        ecs.addComponent(entities.back(), PositionComponent{spots[i].first, spots[i].second, 0.f});
+        ecs.addComponent(entities.back(), CoinComponent{i});
+    }
+
+    MortonReorderSystem<CoinComponent> reorder;
+    reorder(ecs, 0.f, queues);
+
+    // Non-finite entities keep their slots, the rest take the others in
+    // Z-order along the diagonal.
+    CHECK_EQUAL(1, ecs.entityStorage.getComponentIndex<CoinComponent>(entities[1]));
+    CHECK_EQUAL(3, ecs.entityStorage.getComponentIndex<CoinComponent>(entities[3]));
+    CHECK_EQUAL(0, ecs.entityStorage.getComponentIndex<CoinComponent>(entities[2]));
+    CHECK_EQUAL(2, ecs.entityStorage.getComponentIndex<CoinComponent>(entities[5]));
+    CHECK_EQUAL(4, ecs.entityStorage.getComponentIndex<CoinComponent>(entities[0]));
+    CHECK_EQUAL(5, ecs.entityStorage.getComponentIndex<CoinComponent>(entities[4]));
+    for (size_t i = 0; i < entities.size(); ++i) {
+        CHECK_EQUAL(i, ecs.getComponent<CoinComponent>(entities[i])->value);
+    }
+}
+
+TEST(EntityComponentSystemGroup, ParallelStagesRunConflictingSystemsInOrder) {
+    struct Shared { std::vector<int> order; };
+    struct Left { bool sawRight = false; };
+    struct Right { bool sawLeft = false; };
+    struct Undeclared { int value = 0; };
+
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    std::atomic<int> arrived{0};
+    // Independent systems share a wave, so each one waits to see the other.
+    auto meet = [&arrived]() {
+        ++arrived;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (arrived.load() % 2 != 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        return arrived.load() % 2 == 0;
+    };
+
+    ecs.nextStage(ECS::StageType::Parallel)
+        .addSystem([](ECS& ecs, const float&, RenderingQueues&) {
+            ecs.resource<Shared>().order.push_back(1);
+        }).writes<Shared>()
+        .addSystem([&meet](ECS& ecs, const float&, RenderingQueues&) {
+            ecs.resource<Left>().sawRight = meet();
+        }).writes<Left>()
+        .addSystem([](ECS& ecs, const float&, RenderingQueues&) {
+            ecs.resource<Shared>().order.push_back(2);
+        }).writes<Shared>()
+        .addSystem([&meet](ECS& ecs, const float&, RenderingQueues&) {
+            ecs.resource<Right>().sawLeft = meet();
+        }).writes<Right>();
+
+    for (int tick = 0; tick < 3; ++tick) {
+        ecs.update(0.f);
+    }
+    const std::vector<int> expected{1, 2, 1, 2, 1, 2};
+    CHECK_TRUE(ecs.resource<Shared>().order == expected);
+    CHECK_TRUE(ecs.resource<Left>().sawRight);
+    CHECK_TRUE(ecs.resource<Right>().sawLeft);
+
+    // A resource first touched inside a parallel stage is refused.
+    ecs.nextStage(ECS::StageType::Parallel)
+        .addSystem([](ECS& ecs, const float&, RenderingQueues&) {
+            ecs.resource<Undeclared>().value = 1;
+        });
+    bool refused = false;
+    try {
+        ecs.update(0.f);
+    } catch (const std::runtime_error&) {
+        refused = true;
+    }
+    CHECK_TRUE(refused);
+    CHECK_EQUAL(0, ecs.resource<Undeclared>().value);
+}
+
+TEST(EntityComponentSystemGroup, SystemsRunAtTheirRateAndSliceTheirQuery) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    for (int i = 0; i < 10; ++i) {
+        ecs.addComponent(ecs.createEntity(), CoinComponent{1});
+    }
+
+    std::vector<float> everyThird;
+    std::vector<EntityID> visited;
+    ecs.nextStage(ECS::StageType::Sequential)
+        .addSystem([&](ECS&, const float& deltaTime, RenderingQueues&) {
+            everyThird.push_back(deltaTime);
+        }).every(3)
+        .addSystem([&](ECS& ecs, const float&, RenderingQueues&) {
+            const auto& coins = ecs.getEntitiesWithComponent<CoinComponent>().get();
+            for (auto entity : ecs.budgetedSlice(coins)) visited.push_back(entity);
+        }).withBudget(1e-9f);
+
+    for (int tick = 0; tick < 6; ++tick) ecs.update(0.5f);
+
+    CHECK_EQUAL(2, everyThird.size());
+    DOUBLES_EQUAL(1.5f, everyThird[0], 0.0001f);
+    // The first run has no cost estimate and takes the whole query, later
+    // runs get at least one entity each and continue the walk.
+    CHECK_TRUE(visited.size() >= 15);
+    CHECK_TRUE(visited.size() < 60);
+}
+
+TEST(EntityComponentSystemGroup, BudgetedSlicesKeepEntitiesUntilTheyAreReady) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    for (int i = 0; i < 10; ++i) {
+        ecs.addComponent(ecs.createEntity(), CoinComponent{1});
+    }
+
+    // Entities are ready on every fourth tick only, out of phase with a walk
+    // of one entity per run.
+    int tick = 0;
+    std::vector<std::pair<int, EntityID>> visited;
+    size_t mostTests = 0;
+    ecs.nextStage(ECS::StageType::Sequential)
+        .addSystem([&](ECS& ecs, const float&, RenderingQueues&) {
+            const auto& coins = ecs.getEntitiesWithComponent<CoinComponent>().get();
+            size_t tests = 0;
+            auto ready = [&](EntityID entity) { ++tests; return (tick + entity) % 4 == 0; };
+            for (auto entity : ecs.budgetedSlice(coins, ready)) visited.push_back({tick, entity});
+            // The first run has no cost estimate yet and may take the whole query.
+            if (tick > 0) mostTests = std::max(mostTests, tests);
+        }).withBudget(1e-9f);
+
+    for (; tick < 200; ++tick) ecs.update(0.5f);
+
+    // One entity per run is budgeted, so a run tests a bounded number.
+    CHECK_TRUE(mostTests <= 4);
+
+    std::vector<int> visits(10, 0);
+    for (const auto& [when, entity] : visited) {
+        CHECK_EQUAL(0, (when + entity) % 4);
+        ++visits[entity];
+    }
+    for (int count : visits) CHECK_TRUE(count >= 2);
+}
+
+TEST(EntityComponentSystemGroup, FarEntitiesSimulateLessOftenWithScaledStep) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    auto& player = ecs.resource<PlayerState>();
+    player.alive = true;
+
+    auto near = ecs.createEntity();
+    ecs.addComponent(near, PositionComponent{1.f, 0.f, 0.f});
+    ecs.addComponent(near, SimLodComponent{});
+    auto far = ecs.createEntity();
+    ecs.addComponent(far, PositionComponent{500.f, 0.f, 0.f});
+    ecs.addComponent(far, SimLodComponent{});
+
+    RenderingQueues queues;
+    simLodTierSystem(ecs, 0.1f, queues);
+    CHECK_EQUAL(0, ecs.getComponent<SimLodComponent>(near)->tier);
+    CHECK_EQUAL(2, ecs.getComponent<SimLodComponent>(far)->tier);
+
+    int farUpdates = 0;
+    float farTime = 0.f;
+    for (int tick = 0; tick < 32; ++tick) {
+        simLodScheduleSystem(ecs, 0.1f, queues);
+        float step;
+        CHECK_TRUE(simLodDue(ecs, near, 0.1f, step));
+        if (simLodDue(ecs, far, 0.1f, step)) {
+            ++farUpdates;
+            farTime += step;
+        }
+    }
+    CHECK_EQUAL(2, farUpdates);
+    // Time not yet handed out is still accumulating for the next due tick.
+    DOUBLES_EQUAL(3.2f, farTime + ecs.getComponent<SimLodComponent>(far)->elapsed, 0.001f);
+
+    // A step past half a second damps the velocity to rest, it never flips it.
+    ecs.addComponent(far, MovableComponent{10.f, 0.f});
+    ecs.getComponent<MovableComponent>(far)->dx = 5.f;
+    auto& simLod = *ecs.getComponent<SimLodComponent>(far);
+    simLod.due = true;
+    simLod.step = 0.8f;
+    movementSystem(ecs, 0.1f, queues);
+    CHECK_TRUE(ecs.getComponent<MovableComponent>(far)->dx >= 0.f);
+    DOUBLES_EQUAL(500.f, ecs.getComponent<PositionComponent>(far)->x, 1e-4);
+}
+
+TEST(EntityComponentSystemGroup, RestingIslandsSleepAndWakeTogether) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    std::vector<EntityID> pile;
+    for (int i = 0; i < 2; ++i) {
+        pile.push_back(ecs.createEntity());
+        ecs.addComponent(pile.back(), PositionComponent{static_cast<float>(i), 0.f, 0.f});
+        ecs.addComponent(pile.back(), MovableComponent{0.f, 0.f});
+        ecs.addComponent(pile.back(), SleepStateComponent{static_cast<float>(i), 0.f});
+    }
+    // A static wall the pile rests against, and an awake body without sleep state.
+    auto wall = ecs.createEntity();
+    ecs.addComponent(wall, PositionComponent{2.f, 0.f, 0.f});
+    auto walker = ecs.createEntity();
+    ecs.addComponent(walker, PositionComponent{-1.f, 0.f, 0.f});
+    ecs.addComponent(walker, MovableComponent{1.f, 0.f});
+
+    SleepSystem sleepSystem;
+    bool walkerTouches = false;
+    auto tick = [&] {
+        ecs.contacts.clear();
+        ecs.contacts.emit(pile[0], pile[1], 1.f, 0.f, 0.01f);
+        ecs.contacts.emit(pile[1], wall, 1.f, 0.f, 0.01f);
+        if (walkerTouches) ecs.contacts.emit(walker, pile[0], 1.f, 0.f, 0.01f);
+        sleepSystem(ecs, 1.f / 60.f, queues);
+        ecs.flush();
+    };
+
+    for (int i = 0; i < sleep_ticks; ++i) tick();
+    CHECK_TRUE(ecs.entityStorage.hasComponent<SleepingComponent>(pile[0]));
+    CHECK_TRUE(ecs.entityStorage.hasComponent<SleepingComponent>(pile[1]));
+
+    ecs.getComponent<MovableComponent>(pile[1])->dx = 5.f;
+    tick();
+    CHECK_FALSE(ecs.entityStorage.hasComponent<SleepingComponent>(pile[0]));
+    CHECK_FALSE(ecs.entityStorage.hasComponent<SleepingComponent>(pile[1]));
+
+    // Resting against the wall does not keep the pile awake, an awake movable
+    // neighbour does.
+    ecs.getComponent<MovableComponent>(pile[1])->dx = 0.f;
+    for (int i = 0; i < sleep_ticks; ++i) tick();
+    CHECK_TRUE(ecs.entityStorage.hasComponent<SleepingComponent>(pile[1]));
+    walkerTouches = true;
+    tick();
+    CHECK_FALSE(ecs.entityStorage.hasComponent<SleepingComponent>(pile[0]));
+    CHECK_FALSE(ecs.entityStorage.hasComponent<SleepingComponent>(pile[1]));
+}
+
+TEST(EntityComponentSystemGroup, TimersFireOnTheirTickAndCanBeCancelled) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    auto markAction = [](CommandBuffer& commands, EntityID entity) {
+        commands.addComponent(entity, CoinComponent{1});
+    };
+
+    auto soon = ecs.createEntity();
+    auto late = ecs.createEntity();
+    auto cancelled = ecs.createEntity();
+    ecs.timers.schedule(soon, 3, markAction);
+    ecs.timers.schedule(late, 5000, markAction);
+    auto handle = ecs.timers.schedule(cancelled, 10, markAction);
+    CHECK_TRUE(ecs.timers.cancel(handle));
+    CHECK_FALSE(ecs.timers.cancel(handle));
+
+    for (int tick = 0; tick < 4999; ++tick) {
+        ecs.update(0.f);
+        CHECK_EQUAL(tick >= 2, ecs.entityStorage.hasComponent<CoinComponent>(soon));
+    }
+    CHECK_FALSE(ecs.entityStorage.hasComponent<CoinComponent>(late));
+    ecs.update(0.f);
+    CHECK_TRUE(ecs.entityStorage.hasComponent<CoinComponent>(late));
+    CHECK_FALSE(ecs.entityStorage.hasComponent<CoinComponent>(cancelled));
+    CHECK_EQUAL(0, ecs.timers.size());
+}
+
+TEST(EntityComponentSystemGroup, PooledEntitiesAreRecycledInPlace) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    ecs.onAdd<RemoveComponent>(removeEntityObserver);
+    auto prefab = ecs.registerPrefab([](ECS& ecs, EntityID entity) {
+        ecs.setComponent(entity, CoinComponent{3});
+        ecs.getComponent<PooledComponent>(entity)->timer = ecs.timers.schedule(entity, 2, expireEntityAction);
+    });
+    const auto& coins = ecs.getEntitiesWithComponent<CoinComponent>().get();
+
+    auto first = ecs.spawn(prefab);
+    auto* coin = ecs.getComponent<CoinComponent>(first);
+    coin->value = 7;
+    ecs.addComponent(first, RemoveComponent{});
+    ecs.flush();
+    CHECK_TRUE(ecs.entityStorage.hasEntity(first));
+    CHECK_EQUAL(0, coins.size());
+    CHECK_EQUAL(0, ecs.timers.size());
+
+    auto second = ecs.spawn(prefab);
+    CHECK_EQUAL(first, second);
+    CHECK_TRUE(coin == ecs.getComponent<CoinComponent>(second));
+    CHECK_EQUAL(3, coin->value);
+    CHECK_EQUAL(1, coins.size());
+    CHECK_FALSE(ecs.entityStorage.hasComponent<RemoveComponent>(second));
+
+    ecs.update(0.f);
+    ecs.update(0.f);
+    CHECK_EQUAL(0, coins.size());
+    CHECK_EQUAL(1, ecs.entityStorage.getNumberOfEntities());
+    CHECK_EQUAL(0, ecs.entityStorage.getNumberOfActiveEntities());
+}
+
+TEST(EntityComponentSystemGroup, DespawnedSharedRenderablesAreNotDrawn) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderableUnlit cube{DrawCommandPartial<UnlitVertex, UnlitMaterial>{Mesh{36, 0, 0}, 0}};
+    auto prefab = ecs.registerPrefab([cube](ECS& ecs, EntityID entity) {
+        ecs.setComponent(entity, PositionComponent{0.f, 0.f, 0.f});
+        ecs.addSharedComponent(entity, cube);
+    });
+
+    auto first = ecs.spawn(prefab);
+    ecs.spawn(prefab);
+    DrawQueue<UnlitVertex, UnlitMaterial> queue;
+    queueSharedRenderables(ecs, 1.f, nullptr, queue);
+    CHECK_EQUAL(2, queue.size());
+
+    ecs.despawn(first);
+    queue.clear();
+    queueSharedRenderables(ecs, 1.f, nullptr, queue);
+    CHECK_EQUAL(1, queue.size());
+
+    CHECK_EQUAL(first, ecs.spawn(prefab));
+    queue.clear();
+    queueSharedRenderables(ecs, 1.f, nullptr, queue);
+    CHECK_EQUAL(2, queue.size());
+}
+
+TEST(EntityComponentSystemGroup, ContactBufferStoresPairsLowIdFirstAndSorted) {
+    ContactBuffer contacts;
+    contacts.emit(5, 2, 1.f, 0.f, 0.1f);
+    contacts.emit(1, 7, 0.f, 1.f, 0.2f);
+    contacts.emit(1, 3, 0.f, -1.f, 0.3f);
+    contacts.sortByEntity();
+
+    const auto& all = contacts.getAll();
+    CHECK_EQUAL(3, all.size());
+    CHECK_EQUAL(1, all[0].a);
+    CHECK_EQUAL(3, all[0].b);
+    CHECK_EQUAL(7, all[1].b);
+    CHECK_EQUAL(2, all[2].a);
+    CHECK_EQUAL(5, all[2].b);
+    // Swapped pairs flip their normal, so it still points from a to b.
+    DOUBLES_EQUAL(-1.f, all[2].nx, 0.f);
+
+    const size_t capacity = contacts.memoryStats().capacityBytes;
+    contacts.clear();
+    CHECK_EQUAL(0, contacts.size());
+    CHECK_EQUAL(capacity, contacts.memoryStats().capacityBytes);
+}
+
+TEST(EntityComponentSystemGroup, CollisionResolutionSeparatesBodiesAndAppliesRules) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    auto spawn = [&](float x, float y, float r, bool movable) {
+        auto entity = ecs.createEntity();
+        ecs.addComponent(entity, PositionComponent{x, y, 0.f});
+        ecs.addComponent(entity, HitBoxComponent{r});
+        ecs.addComponent(entity, CollidingComponent{});
+        if (movable) ecs.addComponent(entity, MovableComponent{0.f, 0.f});
+        return entity;
+    };
+    auto left = spawn(0.f, 0.f, 1.f, true);
+    auto right = spawn(1.5f, 0.f, 1.f, true);
+    auto wall = spawn(20.f, 0.f, 1.f, false);
+    auto leaning = spawn(21.5f, 0.f, 1.f, true);
+    auto player = spawn(40.f, 0.f, 1.f, true);
+    ecs.addComponent(player, PlayerMovementComponent{});
+    auto bullet = spawn(40.5f, 0.f, 0.5f, true);
+    ecs.addComponent(bullet, BulletComponent{0.f});
+    auto coin = ecs.createEntity();
+    ecs.addComponent(coin, PositionComponent{40.f, 1.f, 0.f});
+    ecs.addComponent(coin, HitBoxComponent{0.3f});
+    ecs.addComponent(coin, CoinComponent{5});
+
+    CollidingSystem<LooseQuadTree> colliding;
+    colliding(ecs, 0.f, queues);
+    collisionResolutionSystem(ecs, 0.f, queues);
+
+    // Two movable bodies share the push, a static one does not move.
+    DOUBLES_EQUAL(-0.1225, ecs.getComponent<PositionComponent>(left)->x, 1e-5);
+    DOUBLES_EQUAL(1.6225, ecs.getComponent<PositionComponent>(right)->x, 1e-5);
+    DOUBLES_EQUAL(20.0, ecs.getComponent<PositionComponent>(wall)->x, 0.0);
+    DOUBLES_EQUAL(21.745, ecs.getComponent<PositionComponent>(leaning)->x, 1e-5);
+
+    // Bullets pass through the player, the player picks up the coin.
+    DOUBLES_EQUAL(40.0, ecs.getComponent<PositionComponent>(player)->x, 0.0);
+    DOUBLES_EQUAL(40.5, ecs.getComponent<PositionComponent>(bullet)->x, 0.0);
+    CHECK_TRUE(ecs.entityStorage.hasComponent<RemoveComponent>(coin));
+    CHECK_FALSE(ecs.entityStorage.hasComponent<RemoveComponent>(bullet));
+}
+
+TEST(EntityComponentSystemGroup, UniformGridFindsEveryOverlapOnce) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    // A dense cluster plus a far outlier stretching the grid bounds.
+    std::vector<EntityID> entities;
+    for (int i = 0; i < 100; ++i) {
+        entities.push_back(ecs.createEntity());
+        const float x = static_cast<float>((i * 37) % 100) * 0.1f;
+        const float y = static_cast<float>((i * 61) % 100) * 0.1f;
+        ecs.addComponent(entities.back(), PositionComponent{x, y, 0.f});
+        ecs.addComponent(entities.back(), HitBoxComponent{0.2f + 0.01f * (i % 30)});
+    }
+    entities.push_back(ecs.createEntity());
+    ecs.addComponent(entities.back(), PositionComponent{5000.f, -5000.f, 0.f});
+    ecs.addComponent(entities.back(), HitBoxComponent{0.5f});
+
+    CollidingSystem<UniformGrid> colliding;
+    colliding(ecs, 0.f, queues);
+
+    size_t expected = 0;
+    for (size_t i = 0; i < entities.size(); ++i) {
+        for (size_t j = i + 1; j < entities.size(); ++j) {
+            auto* a = ecs.getComponent<PositionComponent>(entities[i]);
+            auto* b = ecs.getComponent<PositionComponent>(entities[j]);
+            if (collide(a->x, a->y, ecs.getComponent<HitBoxComponent>(entities[i])->r,
+                        b->x, b->y, ecs.getComponent<HitBoxComponent>(entities[j])->r)) {
+                ++expected;
+            }
+        }
+    }
+    CHECK_TRUE(expected > 0);
+    CHECK_EQUAL(expected, ecs.contacts.size());
+    for (const auto& contact : ecs.contacts.getAll()) {
+        CHECK_TRUE(contact.a < contact.b);
+    }
+}
+
+// Finite proxies find each other, non-finite ones are neither found nor
+// queried, and proxies at the ends of the float range stay apart.
+template<typename Broadphase>
+static void checkBroadphaseSkipsNonFiniteProxies() {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    CollisionProxies proxies;
+    proxies.add(0, 0.f, 0.f, 1.f, true);
+    proxies.add(1, 1.f, 0.f, 1.f, true);
+    proxies.add(2, nan, 0.f, 1.f, true);
+    proxies.add(3, 0.f, 0.f, inf, true);
+    proxies.add(4, -3e38f, -3e38f, 1.f, true);
+    proxies.add(5, 3e38f, 3e38f, 1.f, true);
+
+    Broadphase broadphase;
+    broadphase.build(proxies);
+
+    std::vector<uint32_t> seen;
+    broadphase.query(proxies, 0, [&](uint32_t j) { seen.push_back(j); });
+    std::sort(seen.begin(), seen.end());
+    CHECK_EQUAL(2, seen.size());
+    CHECK_EQUAL(0, seen[0]);
+    CHECK_EQUAL(1, seen[1]);
+
+    size_t visits = 0;
+    broadphase.query(proxies, 2, [&](uint32_t) { ++visits; });
+    broadphase.query(proxies, 3, [&](uint32_t) { ++visits; });
+    CHECK_EQUAL(0, visits);
+    broadphase.query(proxies, 5, [&](uint32_t j) { CHECK_EQUAL(5, j); });
+}
+
+TEST(EntityComponentSystemGroup, BroadphasesSkipNonFiniteProxiesAndBoundTheirCells) {
+    checkBroadphaseSkipsNonFiniteProxies<UniformGrid>();
+    checkBroadphaseSkipsNonFiniteProxies<LinearQuadTree>();
+}
+
+TEST(EntityComponentSystemGroup, LinearQuadTreeRangeQueryMatchesScan) {
+    // Enough points for the sort to split into tasks, plus a stack of
+    // coincident points that can only be separated by the depth limit.
+    CollisionProxies proxies;
+    for (uint32_t i = 0; i < 10000; ++i) {
+        const float x = static_cast<float>((i * 7919) % 1000) * 0.5f;
+        const float y = static_cast<float>((i * 104729) % 997) * 0.5f;
+        proxies.add(i, x, y, 0.5f, true);
+    }
+    for (uint32_t i = 10000; i < 10040; ++i) {
+        proxies.add(i, 100.f, 100.f, 0.5f, true);
+    }
+
+    LinearQuadTree tree;
+    tree.build(proxies);
+
+    const AABB ranges[] = {{100.f, 100.f, 3.f, 3.f}, {0.f, 0.f, 10.f, 10.f}, {250.f, 400.f, 40.f, 5.f}, {-50.f, -50.f, 1.f, 1.f}};
+    for (const auto& range : ranges) {
+        std::vector<EntityID> found;
+        tree.query(range, found);
+        std::sort(found.begin(), found.end());
+
+        std::vector<EntityID> expected;
+        for (size_t i = 0; i < proxies.size(); ++i) {
+            if (range.contains(proxies.x[i], proxies.y[i])) expected.push_back(proxies.ids[i]);
+        }
+        CHECK_TRUE(found == expected);
+    }
+}
+
+TEST(EntityComponentSystemGroup, LooseQuadTreeRelocatesOnlyMovedEntities) {
+    CollisionProxies proxies;
+    auto gather = [&](float drift, size_t count) {
+        proxies.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            const float x = static_cast<float>((i * 37) % 200) + (i % 10 == 0 ? drift : 0.f);
+            const float y = static_cast<float>((i * 61) % 200);
+            proxies.add(i, x, y, 0.3f + 0.1f * (i % 5), true);
+        }
+    };
+    auto checkAgainstScan = [&](const LooseQuadTree& tree, const AABB& range) {
+        std::vector<EntityID> found;
+        tree.query(range, found);
+        std::sort(found.begin(), found.end());
+        std::vector<EntityID> expected;
+        for (size_t i = 0; i < proxies.size(); ++i) {
+            if (std::abs(proxies.x[i] - range.x) <= range.halfW + proxies.r[i] &&
+                std::abs(proxies.y[i] - range.y) <= range.halfH + proxies.r[i]) {
+                expected.push_back(proxies.ids[i]);
+            }
+        }
+        CHECK_TRUE(found == expected);
+    };
+
+    LooseQuadTree tree;
+    gather(0.f, 1000);
+    tree.build(proxies);
+    CHECK_EQUAL(1000, tree.relocated());
+
+    // Nothing moved, nothing is touched.
+    tree.build(proxies);
+    CHECK_EQUAL(0, tree.relocated());
+
+    // A tenth of the entities jumps far, only they are relocated.
+    gather(60.f, 1000);
+    tree.build(proxies);
+    CHECK_TRUE(tree.relocated() > 0);
+    CHECK_TRUE(tree.relocated() <= 100);
+    checkAgainstScan(tree, {50.f, 50.f, 20.f, 10.f});
+    checkAgainstScan(tree, {230.f, 100.f, 30.f, 100.f});
+
+    // Entities missing from a pass leave the tree.
+    gather(60.f, 500);
+    tree.build(proxies);
+    checkAgainstScan(tree, {100.f, 100.f, 150.f, 150.f});
+}
+
+TEST(EntityComponentSystemGroup, LooseQuadTreeGrowsToFollowFarEntities) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    // Overlapping pairs well past the old 500 unit world, on every side.
+    const float spots[][2] = {{0.f, 0.f}, {2500.f, 10.f}, {-8000.f, 3000.f}, {120.f, -40000.f}};
+    for (const auto& spot : spots) {
+        for (float offset : {0.f, 0.5f}) {
+            auto entity = ecs.createEntity();
+            ecs.addComponent(entity, PositionComponent{spot[0] + offset, spot[1], 0.f});
+            ecs.addComponent(entity, HitBoxComponent{0.5f});
+        }
+    }
+    auto lost = ecs.createEntity();
+    ecs.addComponent(lost, PositionComponent{std::nanf(""), 0.f, 0.f});
+    ecs.addComponent(lost, HitBoxComponent{0.5f});
+
+    CollidingSystem<LooseQuadTree> colliding;
+    colliding(ecs, 0.f, queues);
+    CHECK_EQUAL(4, ecs.contacts.size());
+
+    const auto& stats = ecs.resource<BroadphaseStats>();
+    CHECK_EQUAL(9, stats.proxies);
+    CHECK_EQUAL(1, stats.nonFinite);
+    CHECK_TRUE(stats.rootGrowths > 0);
+    DOUBLES_EQUAL(-8000.0, stats.minX, 1e-3);
+    DOUBLES_EQUAL(-40000.0, stats.minY, 1e-3);
+
+    // Walking one pair far out grows the root without losing a contact.
+    for (int step = 0; step < 20; ++step) {
+        for (auto entity : ecs.getEntitiesWithComponent<HitBoxComponent>().get()) {
+            auto* position = ecs.getComponent<PositionComponent>(entity);
+            if (position->x >= 2500.f) position->x += 50000.f;
+        }
+        colliding(ecs, 0.f, queues);
+    }
+    CHECK_EQUAL(4, ecs.contacts.size());
+    CHECK_TRUE(ecs.resource<BroadphaseStats>().maxX > 1e6f);
+}
+
+TEST(EntityComponentSystemGroup, SweepAndPruneFollowsSlidingEntitiesAndWidestAxis) {
+    CollisionProxies proxies;
+    // A horde spread along y, sliding a little further each pass.
+    auto gather = [&](float slide) {
+        proxies.clear();
+        for (uint32_t i = 0; i < 400; ++i) {
+            const float x = static_cast<float>(i % 7) * 0.8f + slide * static_cast<float>(i % 3);
+            const float y = static_cast<float>((i * 53) % 400) * 0.7f;
+            proxies.add(i, x, y, 0.5f, true);
+        }
+    };
+    auto pairs = [&](const SweepAndPrune& sap) {
+        std::set<std::pair<uint32_t, uint32_t>> found;
+        sap.forEachPair([&](uint32_t a, uint32_t b) { found.insert({std::min(a, b), std::max(a, b)}); });
+        return found;
+    };
+    auto scan = [&] {
+        std::set<std::pair<uint32_t, uint32_t>> expected;
+        for (uint32_t a = 0; a < proxies.size(); ++a) {
+            for (uint32_t b = a + 1; b < proxies.size(); ++b) {
+                if (std::abs(proxies.x[a] - proxies.x[b]) <= proxies.r[a] + proxies.r[b] &&
+                    std::abs(proxies.y[a] - proxies.y[b]) <= proxies.r[a] + proxies.r[b]) {
+                    expected.insert({a, b});
+                }
+            }
+        }
+        return expected;
+    };
+
+    SweepAndPrune sap;
+    gather(0.f);
+    sap.build(proxies);
+    CHECK_FALSE(sap.sweepsAlongX());
+    CHECK_TRUE(pairs(sap) == scan());
+
+    // Small slides keep the order nearly sorted.
+    gather(0.1f);
+    sap.build(proxies);
+    CHECK_TRUE(sap.stats().relocated < proxies.size() / 4);
+    CHECK_TRUE(pairs(sap) == scan());
+
+    // query() agrees with the sweep for every proxy.
+    std::vector<size_t> expected(proxies.size(), 0);
+    for (const auto& [a, b] : scan()) {
+        ++expected[a];
+        ++expected[b];
+    }
+    for (uint32_t i = 0; i < proxies.size(); ++i) {
+        size_t overlaps = 0;
+        sap.query(proxies, i, [&](uint32_t j) { overlaps += (j != i); });
+        CHECK_EQUAL(expected[i], overlaps);
+    }
+
+    // Once the horde stretches along x the sweep follows.
+    gather(200.f);
+    sap.build(proxies);
+    CHECK_TRUE(sap.sweepsAlongX());
+    CHECK_TRUE(pairs(sap) == scan());
+}
+
+TEST(EntityComponentSystemGroup, ParallelCollisionsMatchTheSerialPath) {
+    ECS serial(RenderingQueues{nullptr, nullptr});
+    ECS parallel(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    // A crowd large enough for several tasks, with static bodies and bullets mixed in.
+    for (ECS* ecs : {&serial, &parallel}) {
+        for (uint32_t i = 0; i < 3000; ++i) {
+            auto entity = ecs->createEntity();
+            const float x = static_cast<float>((i * 7919) % 600) * 0.1f;
+            const float y = static_cast<float>((i * 104729) % 500) * 0.1f;
+            ecs->addComponent(entity, PositionComponent{x, y, 0.f});
+            ecs->addComponent(entity, HitBoxComponent{0.5f});
+            ecs->addComponent(entity, CollidingComponent{});
+            if (i % 5 != 0) ecs->addComponent(entity, MovableComponent{0.f, 0.f});
+            if (i % 50 == 1) ecs->addComponent(entity, BulletComponent{0.f});
+        }
+    }
+
+    CollidingSystem<LooseQuadTree> colliding;
+    ParallelCollidingSystem<LooseQuadTree> parallelColliding;
+    for (int tick = 0; tick < 3; ++tick) {
+        colliding(serial, 0.f, queues);
+        collisionResolutionSystem(serial, 0.f, queues);
+        parallelColliding(parallel, 0.f, queues);
+        contactRulesSystem(parallel, 0.f, queues);
+
+        CHECK_TRUE(serial.contacts.size() > 0);
+        CHECK_EQUAL(serial.contacts.size(), parallel.contacts.size());
+        for (EntityID entity = 0; entity < 3000; ++entity) {
+            const auto* expected = serial.getComponent<PositionComponent>(entity);
+            const auto* actual = parallel.getComponent<PositionComponent>(entity);
+            DOUBLES_EQUAL(expected->x, actual->x, 1e-4);
+            DOUBLES_EQUAL(expected->y, actual->y, 1e-4);
+        }
+        serial.flush();
+        parallel.flush();
+    }
+}
+
+TEST(EntityComponentSystemGroup, SleepingBodiesAreFoundButDoNotLookForOverlaps) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    auto spawn = [&](float x, bool sleeping) {
+        auto entity = ecs.createEntity();
+        ecs.addComponent(entity, PositionComponent{x, 0.f, 0.f});
+        ecs.addComponent(entity, HitBoxComponent{1.f});
+        if (sleeping) ecs.addComponent(entity, SleepingComponent{});
+        return entity;
+    };
+    spawn(0.f, true);
+    auto sleeper = spawn(1.5f, true);
+    auto walker = spawn(3.f, false);
+
+    // The sleeping pair is not looked for, the walker still finds the sleeper.
+    auto check = [&] {
+        CHECK_EQUAL(1, ecs.contacts.size());
+        CHECK_EQUAL(sleeper, ecs.contacts.getAll()[0].a);
+        CHECK_EQUAL(walker, ecs.contacts.getAll()[0].b);
+    };
+    CollidingSystem<LooseQuadTree> serial;
+    serial(ecs, 0.f, queues);
+    check();
+    ParallelCollidingSystem<LooseQuadTree> parallel;
+    parallel(ecs, 0.f, queues);
+    check();
+}
+
+TEST(EntityComponentSystemGroup, FastMoversHitWhatTheyPassThrough) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    auto target = ecs.createEntity();
+    ecs.addComponent(target, PositionComponent{0.f, 0.f, 0.f});
+    ecs.addComponent(target, HitBoxComponent{0.1f});
+
+    // Both jump from one side of the target to the other within one tick.
+    auto bullet = ecs.createEntity();
+    ecs.addComponent(bullet, PreviousPositionComponent{-10.f, 0.2f, 0.f});
+    ecs.addComponent(bullet, PositionComponent{10.f, 0.2f, 0.f});
+    ecs.addComponent(bullet, HitBoxComponent{0.2f});
+    ecs.addComponent(bullet, ContinuousCollisionComponent{});
+
+    auto stepper = ecs.createEntity();
+    ecs.addComponent(stepper, PreviousPositionComponent{-10.f, -1.f, 0.f});
+    ecs.addComponent(stepper, PositionComponent{10.f, -1.f, 0.f});
+    ecs.addComponent(stepper, HitBoxComponent{0.2f});
+
+    // Passes beside the target, close but never touching.
+    auto miss = ecs.createEntity();
+    ecs.addComponent(miss, PreviousPositionComponent{-10.f, -0.35f, 0.f});
+    ecs.addComponent(miss, PositionComponent{10.f, -0.35f, 0.f});
+    ecs.addComponent(miss, HitBoxComponent{0.2f});
+    ecs.addComponent(miss, ContinuousCollisionComponent{});
+
+    CollidingSystem<LooseQuadTree> colliding;
+    colliding(ecs, 0.f, queues);
+
+    // Only the swept bullet hits the target, the normal is taken at impact.
+    CHECK_EQUAL(1, ecs.contacts.size());
+    const auto& contact = ecs.contacts.getAll().front();
+    CHECK_EQUAL(target, contact.a);
+    CHECK_EQUAL(bullet, contact.b);
+    CHECK_TRUE(contact.nx < -0.5f);  // the bullet came from the left
+    DOUBLES_EQUAL(0.0, contact.depth, 1e-6);
+
+    // Two swept bodies meeting mid-tick collide even though both end apart.
+    ecs.addComponent(stepper, ContinuousCollisionComponent{});
+    ecs.getComponent<PreviousPositionComponent>(stepper)->x = 10.f;
+    ecs.getComponent<PositionComponent>(stepper)->x = -10.f;
+    ecs.getComponent<PreviousPositionComponent>(stepper)->y = -0.35f;
+    ecs.getComponent<PositionComponent>(stepper)->y = -0.35f;
+    colliding(ecs, 0.f, queues);
+    bool headOn = false;
+    for (const auto& c : ecs.contacts.getAll()) headOn |= (c.a == stepper && c.b == miss);
+    CHECK_TRUE(headOn);
+}
+
+TEST(EntityComponentSystemGroup, CollisionLayersRejectPairsBeforeTheNarrowphase) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    // Everything sits on one spot, so only the layer table decides.
+    auto spawn = [&](std::optional<CollisionLayer> layer) {
+        auto entity = ecs.createEntity();
+        ecs.addComponent(entity, PositionComponent{0.f, 0.f, 0.f});
+        ecs.addComponent(entity, HitBoxComponent{0.5f});
+        if (layer) ecs.addComponent(entity, CollisionLayerComponent{*layer});
+        return entity;
+    };
+    auto player = spawn(CollisionLayer::Player);
+    auto bulletA = spawn(CollisionLayer::Bullet);
+    auto bulletB = spawn(CollisionLayer::Bullet);
+    auto follower = spawn(CollisionLayer::Follower);
+    auto tileA = spawn(CollisionLayer::Static);
+    auto tileB = spawn(CollisionLayer::Static);
+    auto plain = spawn(std::nullopt);
+
+    CollidingSystem<LooseQuadTree> colliding;
+    colliding(ecs, 0.f, queues);
+
+    std::set<std::pair<EntityID, EntityID>> pairs;
+    for (const auto& contact : ecs.contacts.getAll()) pairs.insert({contact.a, contact.b});
+    const std::set<std::pair<EntityID, EntityID>> expected = {
+        {player, follower}, {player, tileA}, {player, tileB},
+        {bulletA, follower}, {bulletB, follower}, {bulletA, tileA}, {bulletA, tileB},
+        {bulletB, tileA}, {bulletB, tileB}, {follower, tileA}, {follower, tileB},
+        // Entities without a layer touch everything.
+        {player, plain}, {bulletA, plain}, {bulletB, plain}, {follower, plain}, {tileA, plain}, {tileB, plain},
+    };
+    CHECK_TRUE(pairs == expected);
+}
+
+TEST(EntityComponentSystemGroup, ContactPairsPersistAcrossTicksAndWarmStartSeparation) {
+    ECS ecs(RenderingQueues{nullptr, nullptr});
+    RenderingQueues queues;
+
+    auto spawn = [&](float x, float y, bool movable) {
+        auto entity = ecs.createEntity();
+        ecs.addComponent(entity, PositionComponent{x, y, 0.f});
+        ecs.addComponent(entity, HitBoxComponent{1.f});
+        ecs.addComponent(entity, CollidingComponent{});
+        if (movable) ecs.addComponent(entity, MovableComponent{0.f, 0.f});
+        return entity;
+    };
+    auto wall = spawn(0.f, 0.f, false);
+    auto body = spawn(1.5f, 0.f, true);
+
+    CollidingSystem<LooseQuadTree> colliding;
+    auto tick = [&] {
+        colliding(ecs, 0.f, queues);
+        collisionResolutionSystem(ecs, 0.f, queues);
+    };
+
+    tick();
+    CHECK_EQUAL(1, ecs.contactPairs.began().size());
+    const auto* pair = ecs.contactPairs.find(body, wall);
+    CHECK_TRUE(pair != nullptr);
+    CHECK_EQUAL(0u, pair->age);
+    DOUBLES_EQUAL(1.5 + 0.5 * (0.5 - contact_slop), ecs.getComponent<PositionComponent>(body)->x, 1e-5);
+
+    // The second tick starts from half of the first push, so the body clears
+    // the wall down to the slop instead of only halving its overlap again.
+    tick();
+    CHECK_EQUAL(0, ecs.contactPairs.began().size());
+    pair = ecs.contactPairs.find(wall, body);
+    CHECK_EQUAL(1u, pair->age);
+    DOUBLES_EQUAL(0.5 - contact_slop, pair->accumulatedPush, 1e-5);
+    DOUBLES_EQUAL(2.0 - contact_slop, ecs.getComponent<PositionComponent>(body)->x, 1e-5);
+
+    // Resting on the slop keeps the contact.
+    tick();
+    CHECK_EQUAL(2u, ecs.contactPairs.find(wall, body)->age);
+    DOUBLES_EQUAL(2.0 - contact_slop, ecs.getComponent<PositionComponent>(body)->x, 1e-5);
+
+    ecs.getComponent<PositionComponent>(body)->x = 5.f;
+    tick();
+    CHECK_EQUAL(0, ecs.contacts.size());
+    CHECK_EQUAL(1, ecs.contactPairs.ended().size());
+    CHECK_TRUE(ecs.contactPairs.ended()[0] == std::make_pair(wall, body));
+    CHECK_TRUE(ecs.contactPairs.find(wall, body) == nullptr);
+    CHECK_EQUAL(0, ecs.contactPairs.size());
+
+    // Two movable bodies share the correction. The warm start takes them to
+    // the slop on the second tick without overshooting, so their contact
+    // stays and ages instead of ending and beginning again.
+    auto left = spawn(0.f, -20.f, true);
+    auto right = spawn(1.5f, -20.f, true);
+    for (uint32_t expectedAge = 0; expectedAge < 6; ++expectedAge) {
+        tick();
+        CHECK_EQUAL(expectedAge == 0 ? 1 : 0, ecs.contactPairs.began().size());
+        CHECK_EQUAL(0, ecs.contactPairs.ended().size());
+        CHECK_EQUAL(expectedAge, ecs.contactPairs.find(left, right)->age);
+        const float gap = ecs.getComponent<PositionComponent>(right)->x - ecs.getComponent<PositionComponent>(left)->x;
+        DOUBLES_EQUAL(expectedAge == 0 ? 1.5 + 0.5 * (0.5 - contact_slop) : 2.0 - contact_slop, gap, 1e-5);
+    }
+    ecs.getComponent<PositionComponent>(right)->y += 10.f;
+    tick();
+    CHECK_EQUAL(1, ecs.contactPairs.ended().size());
+
+    // Enough resting pairs to grow the table, all ending at once.
+    std::vector<EntityID> tops;
+    for (uint32_t k = 0; k < 1500; ++k) {
+        spawn(10.f + 5.f * k, 10.f, false);
+        tops.push_back(spawn(10.f + 5.f * k, 11.f, false));
+    }
+    tick();
+    CHECK_EQUAL(1500, ecs.contactPairs.began().size());
+    tick();
+    CHECK_EQUAL(0, ecs.contactPairs.began().size());
+    CHECK_EQUAL(1500, ecs.contactPairs.size());
+    for (auto top : tops) ecs.getComponent<PositionComponent>(top)->y += 100.f;
+    tick();
+    CHECK_EQUAL(1500, ecs.contactPairs.ended().size());
+    CHECK_EQUAL(0, ecs.contactPairs.size());
+}
+
+TEST(EntityComponentSystemGroup, NarrowphaseBatchMatchesScalarCollide) {
+    CollisionProxies proxies;
+    for (uint32_t i = 0; i < 203; ++i) {
+        const float x = static_cast<float>((i * 7919) % 400) * 0.05f;
+        const float y = static_cast<float>((i * 104729) % 300) * 0.05f;
+        proxies.add(i, x, y, 0.2f + static_cast<float>(i % 7) * 0.1f, true);
+    }
+
+    NarrowphaseBatch batch;
+    // Batch sizes around the eight-wide iteration, including none at all.
+    for (uint32_t count : {0u, 1u, 7u, 8u, 9u, 203u}) {
+        for (uint32_t i = 0; i < proxies.size(); i += 17) {
+            batch.clear();
+            std::vector<uint32_t> expected;
+            for (uint32_t j = 0; j < count; ++j) {
+                batch.add(proxies, j);
+                if (collide(proxies.x[i], proxies.y[i], proxies.r[i], proxies.x[j], proxies.y[j], proxies.r[j])) {
+                    expected.push_back(j);
+                }
+            }
+            std::vector<uint32_t> actual;
+            for (uint32_t k : batch.overlapping(proxies.x[i], proxies.y[i], proxies.r[i])) {
+                actual.push_back(batch.candidates[k]);
+            }
+            CHECK_TRUE(actual == expected);
+        }
+    }
+}
+
+TEST(EntityComponentSystemGroup, FixedTimestepCatchesUpAndCarriesTheRemainder) {
+    FixedTimestep timestep(10.0f, 5);
+    DOUBLES_EQUAL(0.1, timestep.getStep(), 1e-6);
+
+    CHECK_EQUAL(2, timestep.advance(0.25f));
+    DOUBLES_EQUAL(0.5, timestep.alpha(), 1e-4);
+    CHECK_EQUAL(0, timestep.advance(0.04f));
+    DOUBLES_EQUAL(0.9, timestep.alpha(), 1e-4);
+    CHECK_EQUAL(1, timestep.advance(0.02f));
+    DOUBLES_EQUAL(0.1, timestep.alpha(), 1e-4);
+
+    // A long stall is clamped and the backlog beyond the step cap dropped.
+    FixedTimestep fast(100.0f, 5);
+    CHECK_EQUAL(5, fast.advance(10.0f));
+    CHECK_TRUE(fast.alpha() < 1.0f);
+    CHECK_EQUAL(0, fast.advance(0.0f));
+}
+
+TEST(EntityComponentSystemGroup, SnapshotMailboxHandsOverTheLatestWholeSnapshot) {
+    SnapshotMailbox<std::array<int, 64>> mailbox;
+    CHECK_FALSE(mailbox.acquire());
+
+    // Latest wins, an unread snapshot is overwritten.
+    mailbox.writeBuffer().fill(1);
+    mailbox.publish();
+    mailbox.writeBuffer().fill(2);
+    mailbox.publish();
+    CHECK_FALSE(mailbox.isConsumed());
+    CHECK_TRUE(mailbox.acquire());
+    CHECK_EQUAL(2, mailbox.readBuffer()[0]);
+    CHECK_TRUE(mailbox.isConsumed());
+    CHECK_FALSE(mailbox.acquire());
+    CHECK_EQUAL(2, mailbox.readBuffer()[63]);
+
+    // Concurrently, every snapshot read is one the writer finished, and
+    // snapshots never go back in time.
+    constexpr int snapshots = 20000;
+    std::thread writer([&] {
+        for (int sequence = 3; sequence < snapshots; ++sequence) {
+            mailbox.writeBuffer().fill(sequence);
+            mailbox.publish();
+        }
+    });
+    int last = 2;
+    bool torn = false;
+    bool backwards = false;
+    while (last < snapshots - 1) {
+        if (!mailbox.acquire()) continue;
+        const auto& snapshot = mailbox.readBuffer();
+        for (int value : snapshot) torn |= value != snapshot[0];
+        backwards |= snapshot[0] < last;
+        last = snapshot[0];
+    }
+    writer.join();
+    CHECK_FALSE(torn);
+    CHECK_FALSE(backwards);
+}